@@ -53,6 +53,296 @@ static unsigned char callcalc_get_key() __naked
 	__asm__("ret");
 }
 
+/* Non-blocking: returns the scan code of the key pressed or 0 */
+static unsigned char callcalc_get_csc() __naked
+{
+	CALLCALC0_POLL(GetCSC);
+	__asm__("ld l, a");
+	__asm__("ret");
+}
+
+/* Sleep until the next interrupt (hardware timer or ON key) */
+static void callcalc_halt() __naked
+{
+	__asm__("ei");
+	__asm__("halt");
+	__asm__("ret");
+}
+
+/* clock at the last key seen, see callcalc_idle_reset */
+static unsigned long idle_since;
+
+/*
+ * Low power replacement for polling callcalc_get_key/callcalc_read_time:
+ * Sleeps with HALT between timer interrupts and wakes up only to check for
+ * a key or a change of the clock. Returns the scan code of the key pressed
+ * or 0 if the clock has advanced, in which case *now is updated. Returns
+ * skIdle (again on every call) if no key came for IDLE_SECONDS since the
+ * last one or callcalc_idle_reset.
+ */
+static unsigned char callcalc_wait_event(unsigned long* now)
+{
+	unsigned long prev = *now;
+	unsigned char scancode;
+
+	while(1) {
+		callcalc_halt();
+
+		if((scancode = callcalc_get_csc()) != 0) {
+			idle_since = *now;
+			return scancode;
+		}
+
+		callcalc_read_time(now);
+		if(*now - idle_since >= IDLE_SECONDS)
+			return skIdle;
+		if(*now != prev)
+			return 0;
+	}
+}
+
+/* Starts the idle time of callcalc_wait_event, call on keys seen elsewhere */
+static void callcalc_idle_reset(unsigned long now)
+{
+	idle_since = now;
+}
+
+/*
+ * Switches to 15 MHz if the hardware supports it and returns the previous
+ * setting to pass to callcalc_cpu_restore. The TI-83+ always runs at 6 MHz.
+ */
+static unsigned char callcalc_cpu_fast()
+{
+	unsigned char prev;
+
+	if(!(hwStatus & 0x80))
+		return 0;
+
+	prev = cpuSpeed & 3;
+	cpuSpeed = 1;
+	return prev;
+}
+
+static void callcalc_cpu_restore(unsigned char speed)
+{
+	if(hwStatus & 0x80)
+		cpuSpeed = speed;
+}
+
+/* CPU speed while hashing, for display */
+static unsigned char callcalc_cpu_mhz()
+{
+	return (hwStatus & 0x80) ? 15 : 6;
+}
+
+/*
+ * -- AppVars --
+ * The routines below are not documented to preserve IX which sdcc uses as
+ * frame pointer, hence it is saved around them.
+ */
+
+/* Results of the last successful callcalc_find_appvar, see ChkFindSym */
+static unsigned int  findsym_vat;
+static unsigned int  findsym_data;     /* size word in RAM or Flash entry */
+static unsigned char findsym_page;     /* 0 if in RAM */
+
+static unsigned char callcalc_chk_find_sym() __naked
+{
+	__asm__("push ix");
+	CALLCALC0(ChkFindSym);
+	__asm__("pop  ix");
+	__asm__("ld   l, #0");
+	__asm__("ret  c");                 /* not found */
+	__asm__("ld   (_findsym_vat), hl");
+	__asm__("ld   (_findsym_data), de");
+	__asm__("ld   a, b");
+	__asm__("ld   (_findsym_page), a");
+	__asm__("ld   l, #1");
+	__asm__("ret");
+}
+
+/* Puts AppVar name (up to 8 chars) into OP1, returns 1 if it exists */
+static unsigned char callcalc_find_appvar(const char* name)
+{
+	memset(OP1, 0, sizeof(OP1));
+	OP1[0] = AppVarObj;
+	strncpy((char*)OP1 + 1, name, 8);
+	return callcalc_chk_find_sym();
+}
+
+/* Deletes the variable found last, from RAM or archive */
+static void callcalc_del_found() __naked
+{
+	__asm__("push ix");
+	__asm__("ld   hl, (_findsym_vat)");
+	__asm__("ld   de, (_findsym_data)");
+	__asm__("ld   a, (_findsym_page)");
+	__asm__("ld   b, a");
+	CALLCALC0(DelVarArc);
+	__asm__("pop  ix");
+	__asm__("ret");
+}
+
+/* AppVar named in OP1 with len bytes, returns a pointer to its size word */
+static unsigned char* callcalc_create_appvar(unsigned int len) __naked
+{
+	len;
+
+	__asm__("ld   hl, #2");
+	__asm__("add  hl, sp");
+	__asm__("ld   a, (hl)");
+	__asm__("inc  hl");
+	__asm__("ld   h, (hl)");
+	__asm__("ld   l, a");
+	__asm__("push ix");
+	CALLCALC0(CreateAppVar);
+	__asm__("pop  ix");
+	__asm__("ex   de, hl");
+	__asm__("ret");
+}
+
+/* Moves the variable named in OP1 to the archive or back to RAM */
+static void callcalc_arc_unarc() __naked
+{
+	__asm__("push ix");
+	CALLCALC0(Arc_Unarc);
+	__asm__("pop  ix");
+	__asm__("ret");
+}
+
+/* Copies len bytes from Flash page:addr (0x4000-0x7fff) to dest */
+static void callcalc_flash_to_ram(unsigned char page, unsigned int addr,
+					void* dest, unsigned int len)
+{
+	page;
+	addr;
+	dest;
+	len;
+
+	__asm__("ld   a, 4(ix)");
+	__asm__("ld   l, 5(ix)");
+	__asm__("ld   h, 6(ix)");
+	__asm__("ld   e, 7(ix)");
+	__asm__("ld   d, 8(ix)");
+	__asm__("ld   c, 9(ix)");
+	__asm__("ld   b, 10(ix)");
+	__asm__("push ix");
+	CALLCALC0(FlashToRam);
+	__asm__("pop  ix");
+}
+
+/*
+ * Locates the contents of the AppVar found last: sets *addr to the byte
+ * after its size word, *size to the size and returns the Flash page, 0 if
+ * it is in RAM.
+ */
+static unsigned char callcalc_found_data(unsigned int* addr,
+							unsigned int* size)
+{
+	unsigned char hdr[10];
+	unsigned char page = findsym_page;
+
+	if(page == 0) {
+		*size = *(unsigned int*)findsym_data;
+		*addr = findsym_data + 2;
+		return 0;
+	}
+
+	/* Flash: status, length, type, type2, version, address, page, name */
+	callcalc_flash_to_ram(page, findsym_data, hdr, sizeof(hdr));
+	*addr = findsym_data + sizeof(hdr) + hdr[9];
+	if(*addr >= 0x8000) {
+		*addr -= 0x4000;
+		page++;
+	}
+	callcalc_flash_to_ram(page, *addr, size, 2);
+	*addr += 2;
+	if(*addr >= 0x8000) {
+		*addr -= 0x4000;
+		page++;
+	}
+	return page;
+}
+
+/*
+ * Copies up to len bytes of AppVar name to buf. Archived AppVars are read
+ * from Flash directly such that they need not be unarchived (which would
+ * mean another Flash write to archive them again). Returns the number of
+ * bytes copied, 0 if the AppVar does not exist.
+ */
+static unsigned int callcalc_appvar_read(const char* name, void* buf,
+							unsigned int len)
+{
+	unsigned char page;
+	unsigned int addr;
+	unsigned int size;
+
+	if(!callcalc_find_appvar(name))
+		return 0;
+
+	page = callcalc_found_data(&addr, &size);
+	if(size < len)
+		len = size;
+	if(page == 0)
+		memcpy(buf, (unsigned char*)addr, len);
+	else
+		callcalc_flash_to_ram(page, addr, buf, len);
+	return len;
+}
+
+/*
+ * Replaces the contents of AppVar name by len bytes from buf and archives
+ * it. Costs one Flash write, hence to be called rarely (i.e. not on every
+ * keypress).
+ *
+ * The old contents are deleted only once the new ones exist: An AppVar of
+ * the same size is unarchived and overwritten in place. Otherwise the new
+ * contents are created and archived under the name spare before the old
+ * AppVar is deleted, i.e. name and spare swap places whenever the size
+ * changes. If RAM or archive are full, the OS shows its error and ends the
+ * program. The old contents then remain archived or the new ones remain in
+ * RAM, possibly both, hence readers need to look at name and spare.
+ */
+static void callcalc_appvar_write(const char* name, const char* spare,
+					const void* buf, unsigned int len)
+{
+	const char* swap;
+	unsigned int addr;
+	unsigned int size;
+
+	if(!callcalc_find_appvar(name) && callcalc_find_appvar(spare)) {
+		swap = name;
+		name = spare;
+		spare = swap;
+	}
+
+	if(callcalc_find_appvar(name)) {
+		callcalc_found_data(&addr, &size);
+		if(size == len) {
+			if(findsym_page != 0) {
+				callcalc_find_appvar(name);
+				callcalc_arc_unarc();
+			}
+			callcalc_find_appvar(name);
+			memcpy((unsigned char*)findsym_data + 2, buf, len);
+			callcalc_arc_unarc();
+			return;
+		}
+	}
+
+	/* left behind next to name by an earlier failure, read already */
+	if(callcalc_find_appvar(spare))
+		callcalc_del_found();
+
+	callcalc_find_appvar(spare);
+	memcpy(callcalc_create_appvar(len) + 2, buf, len);
+	callcalc_find_appvar(spare);
+	callcalc_arc_unarc();
+
+	if(callcalc_find_appvar(name))
+		callcalc_del_found();
+}
+
 /*
  * Does Init, Update, Finall all in one.
  * My attempts to do this with separate procedures failed with the program
@@ -63,6 +353,7 @@ static void callcalc_md5_compute(unsigned char* data, unsigned char length)
 	data;
 	length;
 
+	TRACE(TRACE_MD5);
 	CALLCALC0(MD5Init);
 
 	/* load arg 0 to hl */
@@ -1,5 +1,22 @@
+/*
+ * callcalc_wait_event returns skIdle once no key was pressed for this long,
+ * in place of the OS auto power down which HALT and GetCSC never reach.
+ */
+#define IDLE_SECONDS 240
+
 static void callcalc_clear_lcd_full();
 static void callcalc_puts(const unsigned char* str);
 static void callcalc_read_time(unsigned long* out);
 static unsigned char callcalc_get_key();
+static unsigned char callcalc_get_csc();
+static void callcalc_halt();
+static unsigned char callcalc_wait_event(unsigned long* now);
+static void callcalc_idle_reset(unsigned long now);
+static unsigned char callcalc_cpu_fast();
+static void callcalc_cpu_restore(unsigned char speed);
+static unsigned char callcalc_cpu_mhz();
+static unsigned int callcalc_appvar_read(const char* name, void* buf,
+							unsigned int len);
+static void callcalc_appvar_write(const char* name, const char* spare,
+					const void* buf, unsigned int len);
 static void callcalc_md5_compute(unsigned char* data, unsigned char length);
@@ -0,0 +1,161 @@
+#include "../calculator_routines.h"
+#include "ti84pce.h"
+
+/* RFC 1321 implementation shared with the emulator */
+#include "../md5.c"
+
+/*
+ * ----------------------------------------------------------
+ * -- Low Level -- TI-84 Plus CE Procedures and Functions --
+ * ----------------------------------------------------------
+ *
+ * Same interface as calculator_routines.c, implemented with the OS calls
+ * of the CE C toolchain.
+ */
+
+static void callcalc_clear_lcd_full()
+{
+	os_ClrLCDFull();
+}
+
+/* prints at curRow/curCol and advances them like PutS on the TI-84+ */
+static void callcalc_puts(const unsigned char* str)
+{
+	os_PutStrFull((const char*)str);
+}
+
+/*
+ * The CE OS keeps the date as days since 1997-01-01 plus the time of day,
+ * hence this yields the same value as reading ports 0x45-0x48 on the
+ * TI-84+. Read again if the seconds changed in between.
+ */
+static void callcalc_read_time(unsigned long* out)
+{
+	uint8_t sec;
+
+	do {
+		sec = rtc_Seconds;
+		*out = ((rtc_Days * 24UL + rtc_Hours) * 60UL + rtc_Minutes) *
+								60UL + sec;
+	} while(sec != rtc_Seconds);
+}
+
+/* 2-byte key codes (e.g. from the CATALOG) are reported as 0 */
+static unsigned char callcalc_get_key()
+{
+	uint16_t key = os_GetKey();
+	return (key > 0xff) ? 0 : key;
+}
+
+/* Non-blocking: returns the scan code of the key pressed or 0 */
+static unsigned char callcalc_get_csc()
+{
+	return os_GetCSC();
+}
+
+/* Sleep until the next interrupt (OS timer, keypad or ON key) */
+static void callcalc_halt()
+{
+	__asm__ volatile("ei\n\thalt");
+}
+
+static unsigned long idle_since;
+
+/* see calculator_routines.c */
+static unsigned char callcalc_wait_event(unsigned long* now)
+{
+	unsigned long prev = *now;
+	unsigned char scancode;
+
+	while(1) {
+		callcalc_halt();
+
+		if((scancode = callcalc_get_csc()) != 0) {
+			idle_since = *now;
+			return scancode;
+		}
+
+		callcalc_read_time(now);
+		if(*now - idle_since >= IDLE_SECONDS)
+			return skIdle;
+		if(*now != prev)
+			return 0;
+	}
+}
+
+static void callcalc_idle_reset(unsigned long now)
+{
+	idle_since = now;
+}
+
+/* The eZ80 always runs at 48 MHz, there is nothing to switch */
+static unsigned char callcalc_cpu_fast()
+{
+	return 0;
+}
+
+static void callcalc_cpu_restore(unsigned char speed)
+{
+	(void)speed;
+}
+
+static unsigned char callcalc_cpu_mhz()
+{
+	return 48;
+}
+
+/* see calculator_routines.c, fileioc reads archived AppVars in place */
+static unsigned int callcalc_appvar_read(const char* name, void* buf,
+							unsigned int len)
+{
+	uint8_t handle = ti_Open(name, "r");
+	unsigned int rv;
+
+	if(handle == 0)
+		return 0;
+
+	rv = ti_Read(buf, 1, len, handle);
+	ti_Close(handle);
+	return rv;
+}
+
+/*
+ * see calculator_routines.c, fileioc opening "w" deletes the AppVar first,
+ * hence the new contents always go to spare and name and spare swap places
+ * on every write. fileioc returns its errors instead of ending the program.
+ */
+static void callcalc_appvar_write(const char* name, const char* spare,
+					const void* buf, unsigned int len)
+{
+	uint8_t handle = ti_Open(name, "r");
+	const char* swap;
+
+	if(handle != 0) {
+		ti_Close(handle);
+	} else if((handle = ti_Open(spare, "r")) != 0) {
+		ti_Close(handle);
+		swap = name;
+		name = spare;
+		spare = swap;
+	}
+
+	if((handle = ti_Open(spare, "w")) == 0)
+		return;
+	if(ti_Write(buf, len, 1, handle) != 1 ||
+				!ti_SetArchiveStatus(true, handle)) {
+		ti_Close(handle);
+		return;
+	}
+	ti_Close(handle);
+	ti_Delete(name);
+}
+
+static void callcalc_md5_compute(unsigned char* data, unsigned char length)
+{
+	struct md5_ctx ctx;
+
+	TRACE(TRACE_MD5);
+	md5_init(&ctx);
+	md5_update(&ctx, data, length);
+	md5_final(md5data, &ctx);
+}
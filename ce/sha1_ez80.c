@@ -0,0 +1,62 @@
+/*
+ * SHA-1 block transform for the eZ80 (TI-84 Plus CE), included by sha1.c
+ * instead of the Z80 variant when compiling with TRTOTP_CE.
+ *
+ * The eZ80 has 24-bit registers but still needs library calls for every
+ * 32-bit operation, so the cost is dominated by moving 32-bit values
+ * around. Compared to the Z80 variant, this one
+ *
+ *  - keeps the message schedule in a 16-word ring instead of 80 words,
+ *  - unrolls five rounds such that the variables rotate by renaming
+ *    instead of four 32-bit copies per round,
+ *  - uses unsigned int (24 bit, native) indices instead of bytes which
+ *    would need zero extension for every array access.
+ */
+
+static UINT4 ez80_w(UINT4* w, unsigned int j)
+{
+	if(j >= 16)
+		w[j & 15] = rotl1(w[(j + 13) & 15] ^ w[(j + 8) & 15] ^
+						w[(j + 2) & 15] ^ w[j & 15]);
+	return w[j & 15];
+}
+
+#define EZ80_ROUND5(F, K) \
+	e += rotl5(a) + F(b, c, d) + K + ez80_w(w, i);     b = rotl30(b); \
+	d += rotl5(e) + F(a, b, c) + K + ez80_w(w, i + 1); a = rotl30(a); \
+	c += rotl5(d) + F(e, a, b) + K + ez80_w(w, i + 2); e = rotl30(e); \
+	b += rotl5(c) + F(d, e, a) + K + ez80_w(w, i + 3); d = rotl30(d); \
+	a += rotl5(b) + F(c, d, e) + K + ez80_w(w, i + 4); c = rotl30(c);
+
+static void shs_transform(UINT4* digest, UINT4* in)
+{
+	UINT4 w[16];
+	UINT4 a = digest[0];
+	UINT4 b = digest[1];
+	UINT4 c = digest[2];
+	UINT4 d = digest[3];
+	UINT4 e = digest[4];
+	unsigned int i;
+
+	TRACE(TRACE_SHS);
+	memcpy(w, in, 64);
+
+	for(i = 0; i < 20; i += 5) {
+		EZ80_ROUND5(f1, K1)
+	}
+	for(; i < 40; i += 5) {
+		EZ80_ROUND5(f2, K2)
+	}
+	for(; i < 60; i += 5) {
+		EZ80_ROUND5(f3, K3)
+	}
+	for(; i < 80; i += 5) {
+		EZ80_ROUND5(f2, K4)
+	}
+
+	digest[0] += a;
+	digest[1] += b;
+	digest[2] += c;
+	digest[3] += d;
+	digest[4] += e;
+}
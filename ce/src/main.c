@@ -0,0 +1,16 @@
+/*
+ * TI-84 Plus CE build of trtotp.c, see ../Makefile. The program itself is
+ * shared with the TI-84+ build, only the startup is different: the CE
+ * toolchain wants an int main() and the home screen to be cleaned up.
+ */
+
+#define main trtotp_main
+#include "../../trtotp.c"
+#undef main
+
+int main(void)
+{
+	trtotp_main();
+	os_ClrHome();
+	return 0;
+}
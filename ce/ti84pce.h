@@ -0,0 +1,73 @@
+/*
+ * TI-84 Plus CE counterpart of ti84plus.h for use with the CE C toolchain
+ * (CEdev). Key and scan codes are the same as on the TI-84+.
+ *
+ * THE REFERENCE
+ * https://ce-programming.github.io/toolchain/
+ * ti84pce.inc
+ */
+
+#include <stdint.h>
+#include <ti/screen.h>
+#include <ti/getkey.h>
+#include <ti/getcsc.h>
+#include <sys/rtc.h>
+#include <fileioc.h>
+
+/*
+ * ----------------------------------------------------
+ * -- Ultra low Level -- Macros and Memory Locations --
+ * ----------------------------------------------------
+ */
+#define curRow (*(volatile uint8_t*)0xd00595)
+#define curCol (*(volatile uint8_t*)0xd00596)
+
+/* the CE OS has no MD5 routines, see calculator_routines_ce.c */
+static unsigned char md5data[16];
+
+/* bss is allocated when the program starts and not part of its image */
+static unsigned char appBackUpScreen[768];
+
+#define kRight 0x01
+#define kLeft  0x02
+#define kUp    0x03
+#define kDown  0x04
+#define kEnter 0x05
+#define kDel   0x0a
+
+#define k0     0x8e
+#define k1     0x8f
+#define k2     0x90
+#define k3     0x91
+#define k4     0x92
+#define k5     0x93
+#define k6     0x94
+#define k7     0x95
+#define k8     0x96
+#define k9     0x97
+
+#define kCapA  0x9a
+#define kCapZ  0xb3
+
+/* scan codes as returned by GetCSC */
+#define skDown  0x01
+#define skLeft  0x02
+#define skRight 0x03
+#define skUp    0x04
+#define skEnter 0x09
+#define skClear 0x0f
+#define skDel   0x38
+#define sk2nd   0x36
+#define skAlpha 0x30
+#define skIdle  0xff  /* no key, see IDLE_SECONDS */
+
+#define sk0     0x21
+#define sk1     0x22
+#define sk2     0x1a
+#define sk3     0x12
+#define sk4     0x23
+#define sk5     0x1b
+#define sk6     0x13
+#define sk7     0x24
+#define sk8     0x1c
+#define sk9     0x14
@@ -0,0 +1,299 @@
+/*
+ * Ma_Sys.ma TRTOTP Emulator Profiler 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "symbols.h"
+#include "profile.h"
+
+#define MAX_DEPTH 256
+
+struct func {
+	char name[64];
+	uint64_t self;
+	uint64_t incl;
+	unsigned long calls;
+	unsigned depth;          /* active frames, avoids double counting */
+};
+
+struct edge {
+	size_t caller;
+	size_t callee;
+	unsigned long calls;
+	uint64_t incl;
+};
+
+struct frame {
+	size_t func;
+	size_t caller;
+	uint16_t sp;             /* where the return address was pushed */
+	uint64_t start;
+};
+
+struct profile {
+	const struct symtab* tab;
+
+	/* 0: (unknown), 1..tab->len: symbols, then pseudo functions */
+	struct func* funcs;
+	size_t num_funcs;
+
+	struct edge* edges;
+	size_t num_edges;
+
+	struct frame stack[MAX_DEPTH];
+	size_t depth;
+	unsigned long overflows;
+};
+
+static void xalloc_fail()
+{
+	perror("realloc");
+	exit(2);
+}
+
+static size_t add_func(struct profile* prof, const char* name)
+{
+	prof->funcs = realloc(prof->funcs,
+				(prof->num_funcs + 1) * sizeof(struct func));
+	if(prof->funcs == NULL)
+		xalloc_fail();
+	memset(&prof->funcs[prof->num_funcs], 0, sizeof(struct func));
+	snprintf(prof->funcs[prof->num_funcs].name,
+			sizeof(prof->funcs[0].name), "%s", name);
+	return prof->num_funcs++;
+}
+
+struct profile* profile_new(const struct symtab* tab)
+{
+	struct profile* prof = calloc(1, sizeof(struct profile));
+	size_t i;
+
+	if(prof == NULL)
+		xalloc_fail();
+
+	prof->tab = tab;
+	add_func(prof, "(unknown)");
+	for(i = 0; i < tab->len; i++)
+		add_func(prof, tab->sym[i].name);
+
+	return prof;
+}
+
+void profile_free(struct profile* prof)
+{
+	free(prof->funcs);
+	free(prof->edges);
+	free(prof);
+}
+
+static size_t func_of(struct profile* prof, uint16_t pc)
+{
+	return (size_t)(symtab_index_of(prof->tab, pc) + 1);
+}
+
+static size_t pseudo_of(struct profile* prof, const char* name)
+{
+	size_t i;
+	for(i = prof->tab->len + 1; i < prof->num_funcs; i++)
+		if(strcmp(prof->funcs[i].name, name) == 0)
+			return i;
+	return add_func(prof, name);
+}
+
+/*
+ * Function active at pc. Without frames (main is entered by jp from the
+ * startup code) the symbol at pc is used.
+ */
+static size_t current(struct profile* prof, uint16_t pc)
+{
+	return (prof->depth == 0) ? func_of(prof, pc) :
+				prof->stack[prof->depth - 1].func;
+}
+
+static void add_edge(struct profile* prof, size_t caller, size_t callee,
+							uint64_t incl)
+{
+	size_t i;
+
+	for(i = 0; i < prof->num_edges; i++) {
+		if(prof->edges[i].caller == caller &&
+					prof->edges[i].callee == callee) {
+			prof->edges[i].calls++;
+			prof->edges[i].incl += incl;
+			return;
+		}
+	}
+
+	prof->edges = realloc(prof->edges,
+				(prof->num_edges + 1) * sizeof(struct edge));
+	if(prof->edges == NULL)
+		xalloc_fail();
+	prof->edges[prof->num_edges].caller = caller;
+	prof->edges[prof->num_edges].callee = callee;
+	prof->edges[prof->num_edges].calls = 1;
+	prof->edges[prof->num_edges].incl = incl;
+	prof->num_edges++;
+}
+
+void profile_exec(struct profile* prof, uint16_t pc, unsigned cycles)
+{
+	prof->funcs[func_of(prof, pc)].self += cycles;
+}
+
+void profile_call(struct profile* prof, uint16_t target, uint16_t ret_addr,
+						uint16_t sp, uint64_t busy)
+{
+	size_t callee = func_of(prof, target);
+	struct frame* fr;
+
+	if(prof->depth == MAX_DEPTH) {
+		prof->overflows++;
+		return;
+	}
+
+	prof->funcs[callee].calls++;
+	prof->funcs[callee].depth++;
+
+	fr = &prof->stack[prof->depth];
+	fr->caller = current(prof, ret_addr - 1);
+	prof->depth++;
+	fr->func = callee;
+	fr->sp = sp;
+	fr->start = busy;
+}
+
+static void pop(struct profile* prof, uint64_t busy)
+{
+	struct frame* fr = &prof->stack[--prof->depth];
+	struct func* fn = &prof->funcs[fr->func];
+	uint64_t incl = busy - fr->start;
+
+	/* recursion: only the outermost activation counts */
+	if(--fn->depth == 0)
+		fn->incl += incl;
+	add_edge(prof, fr->caller, fr->func, incl);
+}
+
+/*
+ * A frame ends once its return address has been taken off the stack. This
+ * covers RET as well as helpers like ___sdcc_enter_ix which pop the return
+ * address and leave with jp (hl).
+ */
+void profile_sp(struct profile* prof, uint16_t sp, uint64_t busy)
+{
+	while(prof->depth > 0 && sp > prof->stack[prof->depth - 1].sp)
+		pop(prof, busy);
+}
+
+void profile_pseudo(struct profile* prof, const char* name, uint16_t pc,
+							unsigned long cycles)
+{
+	size_t fn = pseudo_of(prof, name);
+	size_t caller = current(prof, pc);
+
+	prof->funcs[fn].calls++;
+	prof->funcs[fn].self += cycles;
+	prof->funcs[fn].incl += cycles;
+	add_edge(prof, caller, fn, cycles);
+}
+
+/* -- Report -- */
+
+static struct profile* sort_prof;
+
+static int cmp_self(const void* a, const void* b)
+{
+	const struct func* fa = &sort_prof->funcs[*(const size_t*)a];
+	const struct func* fb = &sort_prof->funcs[*(const size_t*)b];
+	if(fa->self != fb->self)
+		return (fa->self > fb->self) ? -1 : 1;
+	return strcmp(fa->name, fb->name);
+}
+
+static int cmp_incl(const void* a, const void* b)
+{
+	const struct func* fa = &sort_prof->funcs[*(const size_t*)a];
+	const struct func* fb = &sort_prof->funcs[*(const size_t*)b];
+	if(fa->incl != fb->incl)
+		return (fa->incl > fb->incl) ? -1 : 1;
+	return strcmp(fa->name, fb->name);
+}
+
+static double pct(uint64_t part, uint64_t total)
+{
+	return (total == 0) ? 0.0 : (part * 100.0 / total);
+}
+
+void profile_report(struct profile* prof, FILE* out)
+{
+	size_t* order = malloc(prof->num_funcs * sizeof(size_t));
+	uint64_t total = 0;
+	size_t i, j, n;
+	struct func* fn;
+	struct edge* ed;
+
+	if(order == NULL)
+		xalloc_fail();
+
+	/* frames still open at the end (e.g. main when the script ends) */
+	for(i = 0; i < prof->depth; i++)
+		prof->funcs[prof->stack[i].func].depth = 0;
+
+	for(i = 0, n = 0; i < prof->num_funcs; i++) {
+		total += prof->funcs[i].self;
+		if(prof->funcs[i].self != 0 || prof->funcs[i].calls != 0)
+			order[n++] = i;
+	}
+
+	sort_prof = prof;
+	qsort(order, n, sizeof(size_t), cmp_self);
+
+	fprintf(out, "Flat profile, %llu busy T-states\n\n",
+						(unsigned long long)total);
+	fprintf(out, "%14s %6s %14s %6s %9s  %s\n", "self T", "self%",
+				"incl T", "incl%", "calls", "function");
+	for(i = 0; i < n; i++) {
+		fn = &prof->funcs[order[i]];
+		fprintf(out, "%14llu %6.2f %14llu %6.2f %9lu  %s\n",
+			(unsigned long long)fn->self, pct(fn->self, total),
+			(unsigned long long)fn->incl, pct(fn->incl, total),
+			fn->calls, fn->name);
+	}
+
+	qsort(order, n, sizeof(size_t), cmp_incl);
+
+	fprintf(out, "\nCall graph (inclusive T-states per edge)\n");
+	for(i = 0; i < n; i++) {
+		fn = &prof->funcs[order[i]];
+		if(fn->calls == 0)
+			continue;
+		fprintf(out, "\n%s  incl %llu T (%.2f%%), self %llu T, "
+			"%lu calls\n", fn->name, (unsigned long long)fn->incl,
+			pct(fn->incl, total), (unsigned long long)fn->self,
+			fn->calls);
+		for(j = 0; j < prof->num_edges; j++) {
+			ed = &prof->edges[j];
+			if(ed->callee == order[i])
+				fprintf(out, "    <- %-24s %9lu calls %14llu T\n",
+					prof->funcs[ed->caller].name,
+					ed->calls, (unsigned long long)ed->incl);
+		}
+		for(j = 0; j < prof->num_edges; j++) {
+			ed = &prof->edges[j];
+			if(ed->caller == order[i])
+				fprintf(out, "    -> %-24s %9lu calls %14llu T\n",
+					prof->funcs[ed->callee].name,
+					ed->calls, (unsigned long long)ed->incl);
+		}
+	}
+
+	if(prof->overflows != 0)
+		fprintf(out, "\nWARNING: %lu calls beyond depth %d ignored\n",
+						prof->overflows, MAX_DEPTH);
+
+	free(order);
+}
@@ -0,0 +1,37 @@
+/*
+ * Ma_Sys.ma TRTOTP Emulator Profiler 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Flat and call graph T-state profiles. Self time is attributed by PC using
+ * the symbol table, inclusive time by following CALLs on a shadow stack.
+ * OS routines and the interrupt handler are accounted as pseudo functions
+ * with their modelled cost. Time spent in HALT is not part of any function.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+struct profile;
+struct symtab;
+
+struct profile* profile_new(const struct symtab* tab);
+void profile_free(struct profile* prof);
+
+/* Instruction at pc took cycles T-states */
+void profile_exec(struct profile* prof, uint16_t pc, unsigned cycles);
+
+/*
+ * busy is the number of non-HALT T-states executed so far, sp the stack
+ * pointer after the instruction (i.e. pointing to the return address for
+ * calls). profile_sp is called after every instruction to end frames.
+ */
+void profile_call(struct profile* prof, uint16_t target, uint16_t ret_addr,
+						uint16_t sp, uint64_t busy);
+void profile_sp(struct profile* prof, uint16_t sp, uint64_t busy);
+
+/* OS routine or interrupt handler called from pc */
+void profile_pseudo(struct profile* prof, const char* name, uint16_t pc,
+							unsigned long cycles);
+
+void profile_report(struct profile* prof, FILE* out);
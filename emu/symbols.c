@@ -0,0 +1,154 @@
+/*
+ * Ma_Sys.ma TRTOTP Emulator Symbol Tables 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "symbols.h"
+
+/* Accepts 0x1234, 1234 and 00001234 (as found in .map files) */
+static int parse_addr(const char* tok, unsigned short* out)
+{
+	char* end;
+	unsigned long v;
+
+	if(tok[0] == '0' && (tok[1] == 'x' || tok[1] == 'X'))
+		tok += 2;
+	if(*tok == 0)
+		return 0;
+	v = strtoul(tok, &end, 16);
+	if(*end != 0 || v > 0xffff)
+		return 0;
+	*out = (unsigned short)v;
+	return 1;
+}
+
+/* Same address: prefer assembler names (_x) over debug records (G$x$0$0) */
+static int cmp_addr(const void* a, const void* b)
+{
+	const struct symbol* sa = a;
+	const struct symbol* sb = b;
+	if(sa->addr != sb->addr)
+		return (sa->addr < sb->addr) ? -1 : 1;
+	if((sa->name[0] == '_') != (sb->name[0] == '_'))
+		return (sa->name[0] == '_') ? -1 : 1;
+	return strcmp(sa->name, sb->name);
+}
+
+/*
+ * With --debug, sdcc also records functions as G$name$0$0 (global) and
+ * F<module>$name$0$0 (static). The latter are the only way to see static
+ * functions. Both are reduced to _name and name respectively. Other debug
+ * records (C$ lines, L/XG/XF scopes) are skipped.
+ */
+static int normalize(const char* in, char* out, size_t outsz)
+{
+	const char* start;
+	const char* end;
+
+	if(in[0] == '_') {
+		snprintf(out, outsz, "%s", in);
+		return 1;
+	}
+	if((in[0] != 'G' && in[0] != 'F') || (start = strchr(in, '$')) == NULL)
+		return 0;
+	start++;
+	if((end = strchr(start, '$')) == NULL || end == start)
+		return 0;
+	snprintf(out, outsz, "%s%.*s", (in[0] == 'G') ? "_" : "",
+						(int)(end - start), start);
+	return 1;
+}
+
+static void add(struct symtab* tab, const char* rawname, unsigned short addr)
+{
+	char name[sizeof(tab->sym[0].name)];
+
+	if(!normalize(rawname, name, sizeof(name)))
+		return;
+
+	tab->sym = realloc(tab->sym, (tab->len + 1) * sizeof(struct symbol));
+	if(tab->sym == NULL) {
+		perror("realloc");
+		exit(2);
+	}
+	snprintf(tab->sym[tab->len].name, sizeof(tab->sym[0].name), "%s",
+									name);
+	tab->sym[tab->len].addr = addr;
+	tab->len++;
+}
+
+int symtab_load(struct symtab* tab, const char* file)
+{
+	FILE* fd;
+	char line[256];
+	char* tok[4];
+	unsigned short addr;
+	size_t i, j;
+	int n;
+
+	if((fd = fopen(file, "r")) == NULL) {
+		perror(file);
+		return -1;
+	}
+
+	while(fgets(line, sizeof(line), fd) != NULL) {
+		n = 0;
+		for(tok[n] = strtok(line, " \t\r\n"); tok[n] != NULL && n < 3;
+					tok[++n] = strtok(NULL, " \t\r\n"))
+			;
+
+		if(n >= 3 && strcmp(tok[0], "DEF") == 0 &&
+						parse_addr(tok[2], &addr))
+			add(tab, tok[1], addr);                  /* .noi */
+		else if(n >= 2 && parse_addr(tok[0], &addr))
+			add(tab, tok[1], addr);                  /* .map */
+		else if(n >= 2 && parse_addr(tok[1], &addr))
+			add(tab, tok[0], addr);                  /* .sym */
+	}
+	fclose(fd);
+
+	qsort(tab->sym, tab->len, sizeof(struct symbol), cmp_addr);
+
+	/* drop aliases */
+	for(i = 0, j = 0; i < tab->len; i++)
+		if(j == 0 || tab->sym[j - 1].addr != tab->sym[i].addr)
+			tab->sym[j++] = tab->sym[i];
+	tab->len = j;
+
+	return 0;
+}
+
+long symtab_index_of(const struct symtab* tab, unsigned short addr)
+{
+	size_t lo = 0;
+	size_t hi = tab->len;
+	size_t mid;
+
+	if(tab->len == 0 || addr < tab->sym[0].addr)
+		return -1;
+
+	/* last symbol with sym.addr <= addr */
+	while(hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if(tab->sym[mid].addr <= addr)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return (long)lo;
+}
+
+const struct symbol* symtab_by_name(const struct symtab* tab,
+							const char* name)
+{
+	size_t i;
+	for(i = 0; i < tab->len; i++)
+		if(strcmp(tab->sym[i].name, name) == 0)
+			return &tab->sym[i];
+	return NULL;
+}
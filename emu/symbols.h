@@ -0,0 +1,35 @@
+/*
+ * Ma_Sys.ma TRTOTP Emulator Symbol Tables 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Reads the symbol files sdcc leaves behind: .noi (DEF _name 0xADDR),
+ * .map (ADDR _name module) and .sym (_name ADDR flags). Static functions are
+ * only found if the program was compiled with --debug. Note that .sym files
+ * of relocatable modules contain area-relative addresses, prefer .noi/.map.
+ */
+
+#include <stddef.h>
+
+struct symbol {
+	char name[48];
+	unsigned short addr;
+};
+
+struct symtab {
+	struct symbol* sym;  /* sorted by address after symtab_load */
+	size_t len;
+};
+
+/* Returns 0 on success, prints an error and returns -1 otherwise */
+int symtab_load(struct symtab* tab, const char* file);
+
+/*
+ * Index of the symbol containing addr (the last one starting at or before
+ * addr) or -1 if addr is before the first symbol.
+ */
+long symtab_index_of(const struct symtab* tab, unsigned short addr);
+
+/* Returns the symbol or NULL if not found */
+const struct symbol* symtab_by_name(const struct symtab* tab,
+							const char* name);
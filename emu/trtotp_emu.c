@@ -0,0 +1,1376 @@
+/*
+ * Ma_Sys.ma TRTOTP Scripted UI Replay 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Runs trtotp.8xp (or the .bin before packing) on an emulated Z80 with the
+ * OS routines replaced by stubs. Keystrokes are taken from a script, after
+ * each step the text screen is captured and the T-states between the
+ * keypress and the screen being final are reported. The screen is
+ * considered final once the program waits again: asks for the next key with
+ * GetKey, executes HALT or exits.
+ *
+ * Hardware timer interrupts are delivered at TIMER_HZ. While the CPU sleeps
+ * in HALT, time is fast-forwarded to the next interrupt and accounted as
+ * idle such that the share of busy T-states can be reported per step.
+ *
+ * By default a TI-84+ is modelled: the program may switch the CPU to 15 MHz
+ * through port 0x20. Time is kept in ticks of TICK_HZ, a multiple of both
+ * CPU speeds, such that T-states at either speed map to exact durations.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "z80.h"
+#include "../md5.h"
+#include "symbols.h"
+#include "profile.h"
+
+/* -- Calculator Model -- */
+
+#define LOAD_ADDR      0x9d93   /* tios_crt0.s: .org 0x9D93 */
+#define START_ADDR     0x9d95   /* after the 0xBB 0x6D token */
+#define EXIT_ADDR      0x0000   /* return address pushed for main */
+#define BCALL_VECTOR   0x0028   /* rst rBR_CALL */
+#define ISR_VECTOR     0x0038   /* interrupt mode 1 */
+#define STACK_TOP      0xffff
+#define IY_FLAGS       0x89f0
+
+#define ADDR_CURROW    0x844b
+#define ADDR_CURCOL    0x844c
+#define ADDR_MD5DATA   0x8292
+#define ADDR_OP1       0x8478
+#define ADDR_APPBACKUP 0x9872       /* appBackUpScreen, 768 bytes */
+
+/*
+ * ../trace.h struct trace at the end of appBackUpScreen, programs compiled
+ * with -DTRTOTP_TRACE only: magic (2), next (4), start (4), TRACE_SLOTS
+ * counters of event (2) and count (4), TRACE_ENTRIES events of event (2)
+ * and seconds since start (2), all little endian.
+ */
+#define TRACE_MAGIC    0x5254
+#define TRACE_SLOTS    16
+#define TRACE_ENTRIES  32
+#define TRACE_SIZE     (10 + 6 * TRACE_SLOTS + 4 * TRACE_ENTRIES)
+#define ADDR_TRACE     (ADDR_APPBACKUP + 768 - TRACE_SIZE)
+
+/*
+ * AppVars are not kept in a VAT. Those in RAM are allocated upwards from
+ * ADDR_USERVARS, archived ones are presented as a Flash page each (page
+ * number 1 + index) starting with the variable header at FLASH_START.
+ */
+#define ADDR_USERVARS  0xd000
+#define ADDR_USERVARS_END 0xf000
+#define FLASH_START    0x4000
+#define FLASH_PAGE     0x4000
+#define VAT_DUMMY      0xfe66
+#define MAX_APPVARS    4
+#define APPVAR_MAX     1024
+#define AppVarObj      0x15
+
+#define SCREEN_ROWS    8
+#define SCREEN_COLS    16
+
+#define CPU_HZ_SLOW    6000000ULL
+#define CPU_HZ_FAST    15000000ULL
+#define TICK_HZ        30000000ULL  /* time base, see tick_mult */
+#define TIMER_HZ       110
+
+#define PORT_STATUS    0x02
+#define PORT_SPEED     0x20         /* not on the TI-83+ */
+
+/* battery ok, LCD ready, bit 5: TI-84+, bit 7: not a TI-83+ */
+#define STATUS_84P     0xa3
+#define STATUS_83P     0x03
+
+/* TZ=UTC date --date="Jan 1 1997 UTC 00:00:00" +%s */
+#define CLOCK_EPOCH    852076800UL
+
+#define DEFAULT_MAX_CYCLES 6000000000ULL
+
+/* trtotp.c: volatile const unsigned int KDFITERATIONS */
+#define SYM_KDFITERATIONS  "_KDFITERATIONS"
+#define CALIBRATE_ITERATIONS 100
+#define MAX_ITERATIONS       65535  /* KDFITERATIONS is a 16 bit int */
+
+/* key codes as returned by GetKey, see ti84plus.h */
+#define kRight 0x01
+#define kLeft  0x02
+#define kUp    0x03
+#define kDown  0x04
+#define kEnter 0x05
+#define kClear 0x09
+#define kDel   0x0a
+#define k0     0x8e
+#define kCapA  0x9a
+
+/* -- Structures -- */
+
+struct event {
+	unsigned char code;      /* 0 for WAIT */
+	unsigned char scan;      /* GetCSC scan code, 0 if not available */
+	unsigned long wait_s;
+	char name[12];
+};
+
+struct step {
+	const struct event* ev;  /* NULL for the initial screen */
+	unsigned long long cycles;
+	unsigned long long busy; /* cycles not spent in HALT */
+	unsigned long long ticks;
+	unsigned long long busy_ticks;
+	unsigned long bcalls;
+	char screen[SCREEN_ROWS][SCREEN_COLS];
+};
+
+struct appvar {
+	char name[9];
+	int archived;
+	unsigned short addr;     /* size word in RAM if not archived */
+	unsigned short len;
+	unsigned char data[APPVAR_MAX];   /* if archived */
+};
+
+struct emu;
+
+struct bcall {
+	const char* name;
+	unsigned short addr;
+	void (*fn)(struct emu*);
+	unsigned long cost;      /* modelled T-states per invocation */
+	unsigned long calls;
+};
+
+struct emu {
+	struct z80 cpu;
+	unsigned char mem[65536];
+	char screen[SCREEN_ROWS][SCREEN_COLS];
+	struct md5_ctx md5;
+
+	struct appvar appvars[MAX_APPVARS];
+	size_t num_appvars;
+	unsigned short uservars_end;       /* next free byte for RAM AppVars */
+	unsigned long flash_writes;        /* calls to Arc_Unarc */
+	struct appvar initial_appvars[MAX_APPVARS];  /* -a, for restart */
+	size_t num_initial_appvars;
+
+	int model_83p;                     /* no 15 MHz mode */
+	unsigned char speed;               /* port 0x20, 0: 6 MHz, 15 MHz else */
+
+	unsigned long clock_base;          /* clock value at program start */
+	unsigned long long idle_ns;        /* time spent waiting for keys */
+	unsigned long long ticks;          /* time executing, in 1/TICK_HZ s */
+	unsigned long long halted;         /* cycles spent in HALT */
+	unsigned long long halted_ticks;
+	unsigned long long next_irq;       /* ticks at next timer interrupt */
+	unsigned long isr_cost;            /* modelled T-states per interrupt */
+	unsigned long interrupts;
+
+	int waiting;                       /* WAIT in progress for GetCSC */
+	unsigned long long wait_until;     /* in ns, see emu_time_ns */
+
+	struct event* script;
+	size_t script_len;
+	size_t script_pos;
+
+	struct step* steps;
+	size_t num_steps;
+	int step_open;
+	const struct event* step_ev;
+	unsigned long long step_start;     /* cycles at last key delivery */
+	unsigned long long step_halted;    /* halted cycles at key delivery */
+	unsigned long long step_ticks;
+	unsigned long long step_halted_ticks;
+	unsigned long step_bcalls;
+
+	unsigned long long max_cycles;
+	int finished;
+
+	struct profile* prof;              /* NULL unless profiling */
+};
+
+/* -- Time -- */
+
+/* ticks per T-state at the current CPU speed */
+static unsigned tick_mult(struct emu* emu)
+{
+	return (emu->speed & 3) ? (TICK_HZ / CPU_HZ_FAST) :
+						(TICK_HZ / CPU_HZ_SLOW);
+}
+
+static unsigned long long emu_time_ns(struct emu* emu)
+{
+	return emu->ticks * 100 / (TICK_HZ / 10000000) + emu->idle_ns;
+}
+
+/* T-states not spent in HALT */
+static unsigned long long emu_busy(struct emu* emu)
+{
+	return emu->cpu.cycles - emu->halted;
+}
+
+static unsigned long emu_clock(struct emu* emu)
+{
+	return emu->clock_base + (unsigned long)(emu_time_ns(emu) /
+							1000000000ULL);
+}
+
+/* -- Screen -- */
+
+static void screen_clear(struct emu* emu)
+{
+	memset(emu->screen, ' ', sizeof(emu->screen));
+}
+
+static void screen_putc(struct emu* emu, char c)
+{
+	unsigned char row = emu->mem[ADDR_CURROW];
+	unsigned char col = emu->mem[ADDR_CURCOL];
+
+	if(row >= SCREEN_ROWS)
+		row = SCREEN_ROWS - 1;
+	if(col >= SCREEN_COLS)
+		col = SCREEN_COLS - 1;
+
+	emu->screen[row][col] = (c >= 0x20 && c < 0x7f) ? c : '?';
+
+	if(++col >= SCREEN_COLS) {
+		col = 0;
+		if(++row >= SCREEN_ROWS) {
+			/* scroll */
+			memmove(emu->screen[0], emu->screen[1],
+					SCREEN_COLS * (SCREEN_ROWS - 1));
+			memset(emu->screen[SCREEN_ROWS - 1], ' ', SCREEN_COLS);
+			row = SCREEN_ROWS - 1;
+		}
+	}
+
+	emu->mem[ADDR_CURROW] = row;
+	emu->mem[ADDR_CURCOL] = col;
+}
+
+static void screen_print(FILE* out, char screen[SCREEN_ROWS][SCREEN_COLS])
+{
+	unsigned char row;
+
+	fputs("\t+----------------+\n", out);
+	for(row = 0; row < SCREEN_ROWS; row++)
+		fprintf(out, "\t|%.*s|\n", SCREEN_COLS, screen[row]);
+	fputs("\t+----------------+\n", out);
+}
+
+/* -- Steps -- */
+
+static void step_begin(struct emu* emu, const struct event* ev)
+{
+	emu->step_open = 1;
+	emu->step_ev = ev;
+	emu->step_start = emu->cpu.cycles;
+	emu->step_halted = emu->halted;
+	emu->step_ticks = emu->ticks;
+	emu->step_halted_ticks = emu->halted_ticks;
+	emu->step_bcalls = 0;
+}
+
+static void step_finish(struct emu* emu)
+{
+	struct step* s;
+
+	if(!emu->step_open)
+		return;
+	emu->step_open = 0;
+
+	emu->steps = realloc(emu->steps,
+				(emu->num_steps + 1) * sizeof(struct step));
+	if(emu->steps == NULL) {
+		perror("realloc");
+		exit(2);
+	}
+
+	s = &emu->steps[emu->num_steps];
+	s->ev = emu->step_ev;
+	s->cycles = emu->cpu.cycles - emu->step_start;
+	s->busy = s->cycles - (emu->halted - emu->step_halted);
+	s->ticks = emu->ticks - emu->step_ticks;
+	s->busy_ticks = s->ticks - (emu->halted_ticks - emu->step_halted_ticks);
+	s->bcalls = emu->step_bcalls;
+	memcpy(s->screen, emu->screen, sizeof(emu->screen));
+	emu->num_steps++;
+}
+
+/* Returns the next key code or 0 if the script is exhausted */
+static unsigned char next_key(struct emu* emu)
+{
+	struct event* ev;
+
+	while(emu->script_pos < emu->script_len) {
+		ev = &emu->script[emu->script_pos++];
+		if(ev->code != 0) {
+			step_begin(emu, ev);
+			return ev->code;
+		}
+		emu->idle_ns += ev->wait_s * 1000000000ULL;
+	}
+	return 0;
+}
+
+/* -- OS Routine Stubs -- */
+
+static unsigned short reg_hl(struct emu* emu)
+{
+	return (emu->cpu.h << 8) | emu->cpu.l;
+}
+
+static void stub_clear_lcd(struct emu* emu)
+{
+	screen_clear(emu);
+}
+
+static void stub_puts(struct emu* emu)
+{
+	unsigned short ptr = reg_hl(emu);
+	while(emu->mem[ptr] != 0)
+		screen_putc(emu, emu->mem[ptr++]);
+}
+
+/* Leaves the rest of a WAIT started by GetCSC to the user */
+static void wait_finish(struct emu* emu)
+{
+	unsigned long long now = emu_time_ns(emu);
+
+	if(!emu->waiting)
+		return;
+	if(emu->wait_until > now)
+		emu->idle_ns += emu->wait_until - now;
+	emu->waiting = 0;
+	step_finish(emu);
+}
+
+static void stub_get_key(struct emu* emu)
+{
+	unsigned char key;
+
+	wait_finish(emu);
+	step_finish(emu);
+	key = next_key(emu);
+	if(key == 0)
+		emu->finished = 1;
+	emu->cpu.a = key;
+}
+
+/*
+ * Polling variant: a WAIT in the script makes GetCSC return 0 until the
+ * time has passed on the emulated clock. The WAIT is a step of its own such
+ * that the busy share of live views can be reported.
+ */
+static void stub_get_csc(struct emu* emu)
+{
+	struct event* ev;
+
+	emu->cpu.a = 0;
+
+	if(emu->waiting) {
+		if(emu_time_ns(emu) < emu->wait_until)
+			return;
+		emu->waiting = 0;
+		step_finish(emu);
+	}
+
+	if(emu->script_pos >= emu->script_len) {
+		emu->finished = 1;
+		return;
+	}
+
+	ev = &emu->script[emu->script_pos++];
+	step_finish(emu);
+	step_begin(emu, ev);
+
+	if(ev->code == 0) {
+		emu->waiting = 1;
+		emu->wait_until = emu_time_ns(emu) +
+					ev->wait_s * 1000000000ULL;
+	} else if(ev->scan == 0) {
+		fprintf(stderr, "ERROR: Key %s cannot be read by GetCSC\n",
+								ev->name);
+		exit(2);
+	} else {
+		emu->cpu.a = ev->scan;
+	}
+}
+
+static void stub_md5_init(struct emu* emu)
+{
+	md5_init(&emu->md5);
+}
+
+static void stub_md5_update(struct emu* emu)
+{
+	unsigned short ptr = reg_hl(emu);
+	unsigned short len = (emu->cpu.b << 8) | emu->cpu.c;
+
+	if((unsigned long)ptr + len > sizeof(emu->mem)) {
+		fprintf(stderr, "ERROR: MD5Update beyond end of memory\n");
+		exit(2);
+	}
+	md5_update(&emu->md5, emu->mem + ptr, len);
+}
+
+static void stub_md5_final(struct emu* emu)
+{
+	md5_final(emu->mem + ADDR_MD5DATA, &emu->md5);
+}
+
+/* Name in OP1 if it denotes an AppVar, NULL otherwise */
+static const char* op1_appvar(struct emu* emu, char name[9])
+{
+	if((emu->mem[ADDR_OP1] & 0x1f) != AppVarObj)
+		return NULL;
+	memcpy(name, emu->mem + ADDR_OP1 + 1, 8);
+	name[8] = 0;
+	return name;
+}
+
+static struct appvar* appvar_by_name(struct emu* emu, const char* name)
+{
+	size_t i;
+	for(i = 0; i < emu->num_appvars; i++)
+		if(strcmp(emu->appvars[i].name, name) == 0)
+			return &emu->appvars[i];
+	return NULL;
+}
+
+static void appvar_remove(struct emu* emu, struct appvar* var)
+{
+	size_t idx = var - emu->appvars;
+	memmove(var, var + 1, (emu->num_appvars - idx - 1) * sizeof(*var));
+	emu->num_appvars--;
+}
+
+/* Flash page as it would look for an archived AppVar */
+static size_t appvar_flash_image(const struct appvar* var,
+				unsigned char* buf, unsigned char page)
+{
+	size_t namelen = strlen(var->name);
+	size_t len = 10 + namelen + 2 + var->len;
+
+	buf[0] = 0xfc;                    /* valid */
+	buf[1] = (len - 3) & 0xff;
+	buf[2] = (len - 3) >> 8;
+	buf[3] = AppVarObj;
+	buf[4] = 0;
+	buf[5] = 0;
+	buf[6] = FLASH_START & 0xff;
+	buf[7] = FLASH_START >> 8;
+	buf[8] = page;
+	buf[9] = namelen;
+	memcpy(buf + 10, var->name, namelen);
+	buf[10 + namelen] = var->len & 0xff;
+	buf[11 + namelen] = var->len >> 8;
+	memcpy(buf + 12 + namelen, var->data, var->len);
+	return len;
+}
+
+/* Carry set if not found, else HL=VAT entry, DE=data, B=Flash page or 0 */
+static void stub_chk_find_sym(struct emu* emu)
+{
+	char name[9];
+	struct appvar* var;
+
+	if(op1_appvar(emu, name) == NULL ||
+				(var = appvar_by_name(emu, name)) == NULL) {
+		emu->cpu.f |= Z80_FLAG_C;
+		return;
+	}
+	emu->cpu.f &= ~Z80_FLAG_C;
+	emu->cpu.h = VAT_DUMMY >> 8;
+	emu->cpu.l = VAT_DUMMY & 0xff;
+	if(var->archived) {
+		emu->cpu.d = FLASH_START >> 8;
+		emu->cpu.e = FLASH_START & 0xff;
+		emu->cpu.b = 1 + (var - emu->appvars);
+	} else {
+		emu->cpu.d = var->addr >> 8;
+		emu->cpu.e = var->addr & 0xff;
+		emu->cpu.b = 0;
+	}
+}
+
+/* HL=length, name in OP1, returns DE=size word */
+static void stub_create_appvar(struct emu* emu)
+{
+	unsigned short len = reg_hl(emu);
+	char name[9];
+	struct appvar* var;
+
+	if(op1_appvar(emu, name) == NULL || appvar_by_name(emu, name) != NULL
+				|| emu->num_appvars == MAX_APPVARS
+				|| len > APPVAR_MAX
+				|| emu->uservars_end + 2 + len > ADDR_USERVARS_END) {
+		fprintf(stderr, "ERROR: CreateAppVar %s with %u bytes not "
+						"supported\n", name, len);
+		exit(2);
+	}
+	var = &emu->appvars[emu->num_appvars++];
+	memset(var, 0, sizeof(*var));
+	strcpy(var->name, name);
+	var->addr = emu->uservars_end;
+	var->len = len;
+	emu->uservars_end += 2 + len;
+	emu->mem[var->addr] = len & 0xff;
+	emu->mem[var->addr + 1] = len >> 8;
+	emu->cpu.d = var->addr >> 8;
+	emu->cpu.e = var->addr & 0xff;
+	emu->cpu.h = VAT_DUMMY >> 8;
+	emu->cpu.l = VAT_DUMMY & 0xff;
+}
+
+/* HL=VAT entry, DE=data, B=Flash page as returned by ChkFindSym */
+static void stub_del_var_arc(struct emu* emu)
+{
+	unsigned short data = (emu->cpu.d << 8) | emu->cpu.e;
+	size_t i;
+
+	for(i = 0; i < emu->num_appvars; i++) {
+		if(emu->cpu.b == 0 ? (!emu->appvars[i].archived &&
+					emu->appvars[i].addr == data) :
+					(emu->appvars[i].archived &&
+					emu->cpu.b == 1 + i)) {
+			appvar_remove(emu, &emu->appvars[i]);
+			return;
+		}
+	}
+	fprintf(stderr, "ERROR: DelVarArc of unknown variable %u:%04x\n",
+							emu->cpu.b, data);
+	exit(2);
+}
+
+/* Moves the AppVar named in OP1 between RAM and archive */
+static void stub_arc_unarc(struct emu* emu)
+{
+	char name[9];
+	struct appvar* var;
+
+	if(op1_appvar(emu, name) == NULL ||
+				(var = appvar_by_name(emu, name)) == NULL) {
+		fprintf(stderr, "ERROR: Arc_Unarc of unknown variable\n");
+		exit(2);
+	}
+	emu->flash_writes++;
+	if(!var->archived) {
+		memcpy(var->data, emu->mem + var->addr + 2, var->len);
+		var->archived = 1;
+		return;
+	}
+	/* RAM of deleted or unarchived AppVars is not reused */
+	if(emu->uservars_end + 2 + var->len > ADDR_USERVARS_END) {
+		fprintf(stderr, "ERROR: Unarchiving %s: out of RAM\n", name);
+		exit(2);
+	}
+	var->addr = emu->uservars_end;
+	var->archived = 0;
+	emu->uservars_end += 2 + var->len;
+	emu->mem[var->addr] = var->len & 0xff;
+	emu->mem[var->addr + 1] = var->len >> 8;
+	memcpy(emu->mem + var->addr + 2, var->data, var->len);
+}
+
+/* A=page, HL=address, DE=destination, BC=length */
+static void stub_flash_to_ram(struct emu* emu)
+{
+	static unsigned char flash[10 + 8 + 2 + APPVAR_MAX];
+	unsigned char page = emu->cpu.a;
+	unsigned short addr = reg_hl(emu);
+	unsigned short dest = (emu->cpu.d << 8) | emu->cpu.e;
+	unsigned short len = (emu->cpu.b << 8) | emu->cpu.c;
+	unsigned long offset;
+	size_t flash_len;
+
+	if(page == 0 || page > emu->num_appvars ||
+					!emu->appvars[page - 1].archived) {
+		fprintf(stderr, "ERROR: FlashToRam from unused page %u\n",
+									page);
+		exit(2);
+	}
+	flash_len = appvar_flash_image(&emu->appvars[page - 1], flash, page);
+	offset = addr - FLASH_START;
+	if(addr < FLASH_START || offset + len > flash_len ||
+				(unsigned long)dest + len > sizeof(emu->mem)) {
+		fprintf(stderr, "ERROR: FlashToRam %u:%04x+%u out of range\n",
+							page, addr, len);
+		exit(2);
+	}
+	memcpy(emu->mem + dest, flash + offset, len);
+}
+
+static struct bcall BCALLS[] = {
+	{ "ClrLCDFull",  0x4540, stub_clear_lcd,  0, 0 },
+	{ "ClrScrnFull", 0x4546, stub_clear_lcd,  0, 0 },
+	{ "PutS",        0x450a, stub_puts,       0, 0 },
+	{ "GetKey",      0x4972, stub_get_key,    0, 0 },
+	{ "GetCSC",      0x4018, stub_get_csc,    0, 0 },
+	{ "MD5Final",    0x8018, stub_md5_final,  0, 0 },
+	{ "MD5Init",     0x808d, stub_md5_init,   0, 0 },
+	{ "MD5Update",   0x8090, stub_md5_update, 0, 0 },
+	{ "ChkFindSym",  0x42f1, stub_chk_find_sym,  0, 0 },
+	{ "CreateAppVar",0x4e6a, stub_create_appvar, 0, 0 },
+	{ "DelVarArc",   0x4fc6, stub_del_var_arc,   0, 0 },
+	{ "Arc_Unarc",   0x4fd8, stub_arc_unarc,     0, 0 },
+	{ "FlashToRam",  0x5017, stub_flash_to_ram,  0, 0 },
+};
+
+#define NUM_BCALLS (sizeof(BCALLS)/sizeof(struct bcall))
+
+static struct bcall* bcall_by_name(const char* name)
+{
+	size_t i;
+	for(i = 0; i < NUM_BCALLS; i++)
+		if(strcmp(BCALLS[i].name, name) == 0)
+			return &BCALLS[i];
+	return NULL;
+}
+
+/* PC is at BCALL_VECTOR: the routine address follows the rst instruction */
+static void do_bcall(struct emu* emu)
+{
+	unsigned short ret = z80_pop(&emu->cpu);
+	unsigned short addr = emu->mem[ret] | (emu->mem[ret + 1] << 8);
+	char name[32];
+	size_t i;
+
+	for(i = 0; i < NUM_BCALLS; i++) {
+		if(BCALLS[i].addr == addr) {
+			BCALLS[i].calls++;
+			emu->step_bcalls++;
+			emu->cpu.cycles += BCALLS[i].cost;
+			if(emu->prof != NULL) {
+				snprintf(name, sizeof(name), "[%s]",
+							BCALLS[i].name);
+				profile_pseudo(emu->prof, name, ret - 1,
+							BCALLS[i].cost);
+			}
+			BCALLS[i].fn(emu);
+			emu->cpu.pc = ret + 2;
+			return;
+		}
+	}
+
+	fprintf(stderr, "ERROR: Unsupported bcall 0x%04x called from 0x%04x\n",
+								addr, ret - 1);
+	exit(2);
+}
+
+/* -- I/O Ports -- */
+
+static unsigned char port_in(void* ctx, unsigned short port)
+{
+	struct emu* emu = ctx;
+
+	switch(port & 0xff) {
+	case 0x45: return  emu_clock(emu)        & 0xff;
+	case 0x46: return (emu_clock(emu) >>  8) & 0xff;
+	case 0x47: return (emu_clock(emu) >> 16) & 0xff;
+	case 0x48: return (emu_clock(emu) >> 24) & 0xff;
+	case PORT_STATUS: return emu->model_83p ? STATUS_83P : STATUS_84P;
+	case PORT_SPEED:  return emu->speed;
+	default:   return 0;
+	}
+}
+
+static void port_out(void* ctx, unsigned short port, unsigned char val)
+{
+	struct emu* emu = ctx;
+
+	/* other writes are ignored */
+	if((port & 0xff) == PORT_SPEED && !emu->model_83p)
+		emu->speed = val & 3;
+}
+
+/* -- Loading -- */
+
+static size_t load_program(struct emu* emu, const char* file)
+{
+	FILE* fd;
+	unsigned char* buf;
+	long len;
+	size_t off = 0;
+	size_t size;
+
+	if((fd = fopen(file, "rb")) == NULL) {
+		perror(file);
+		exit(2);
+	}
+	fseek(fd, 0, SEEK_END);
+	len = ftell(fd);
+	fseek(fd, 0, SEEK_SET);
+	buf = malloc(len);
+	if(buf == NULL || fread(buf, 1, len, fd) != (size_t)len) {
+		fprintf(stderr, "ERROR: Failed to read %s\n", file);
+		exit(2);
+	}
+	fclose(fd);
+
+	size = len;
+	if(len > 74 && memcmp(buf, "**TI83F*", 8) == 0) {
+		/* .8xp: 55 byte header, variable header, 2 byte size */
+		off  = 55 + 2 + (buf[55] | (buf[56] << 8)) + 2;
+		size = buf[off] | (buf[off + 1] << 8);
+		off += 2;
+		if(off + size > (size_t)len) {
+			fprintf(stderr, "ERROR: Truncated .8xp file %s\n",
+									file);
+			exit(2);
+		}
+	}
+
+	if(size < 2 || buf[off] != 0xbb || buf[off + 1] != 0x6d) {
+		fprintf(stderr, "ERROR: %s is not an assembly program\n", file);
+		exit(2);
+	}
+	if(LOAD_ADDR + size > sizeof(emu->mem)) {
+		fprintf(stderr, "ERROR: %s does not fit into memory\n", file);
+		exit(2);
+	}
+
+	memcpy(emu->mem + LOAD_ADDR, buf + off, size);
+	free(buf);
+	return size;
+}
+
+/* Makes the contents of file available as archived AppVar name */
+static void appvar_load(struct emu* emu, const char* name, const char* file)
+{
+	FILE* fd;
+	struct appvar* var;
+
+	if(strlen(name) > 8) {
+		fprintf(stderr, "ERROR: AppVar name %s too long\n", name);
+		exit(2);
+	}
+	/* a missing file is treated as not yet existing AppVar */
+	if((fd = fopen(file, "rb")) == NULL)
+		return;
+
+	var = &emu->appvars[emu->num_appvars++];
+	memset(var, 0, sizeof(*var));
+	strcpy(var->name, name);
+	var->archived = 1;
+	var->len = fread(var->data, 1, sizeof(var->data), fd);
+	fclose(fd);
+}
+
+/*
+ * Writes archived AppVar name back to file if the program archived it.
+ * Removes file if the program deleted the AppVar (or never created it).
+ */
+static void appvar_save(struct emu* emu, const char* name, const char* file)
+{
+	FILE* fd;
+	struct appvar* var;
+
+	if(emu->flash_writes == 0)
+		return;
+	if((var = appvar_by_name(emu, name)) == NULL) {
+		if(remove(file) != 0 && errno != ENOENT) {
+			perror(file);
+			exit(2);
+		}
+		return;
+	}
+	if(!var->archived)
+		return;
+	if((fd = fopen(file, "wb")) == NULL ||
+			fwrite(var->data, 1, var->len, fd) != var->len) {
+		perror(file);
+		exit(2);
+	}
+	fclose(fd);
+}
+
+/* -- Script -- */
+
+static const struct {
+	const char* name;
+	unsigned char code;
+	unsigned char scan;
+} KEY_NAMES[] = {
+	{ "RIGHT", kRight, 0x03 }, { "LEFT",  kLeft,  0x02 },
+	{ "UP",    kUp,    0x04 }, { "DOWN",  kDown,  0x01 },
+	{ "ENTER", kEnter, 0x09 }, { "CLEAR", kClear, 0x0f },
+	{ "DEL",   kDel,   0x38 },
+};
+
+/* GetCSC scan codes of the keys 0-9 and of the keys labelled ALPHA A-Z */
+static const unsigned char SCAN_DIGITS[10] = {
+	0x21, 0x22, 0x1a, 0x12, 0x23, 0x1b, 0x13, 0x24, 0x1c, 0x14,
+};
+static const unsigned char SCAN_LETTERS[26] = {
+	0x2f, 0x27, 0x1f, 0x2e, 0x26, 0x1e, 0x16, 0x0e, 0x2d, 0x25,
+	0x1d, 0x15, 0x0d, 0x2c, 0x24, 0x1c, 0x14, 0x0c, 0x2b, 0x23,
+	0x1b, 0x13, 0x0b, 0x2a, 0x22, 0x1a,
+};
+
+static void script_add(struct emu* emu, const char* tok)
+{
+	struct event ev;
+	size_t i;
+
+	memset(&ev, 0, sizeof(struct event));
+	snprintf(ev.name, sizeof(ev.name), "%s", tok);
+
+	if(strncmp(tok, "WAIT:", 5) == 0) {
+		ev.wait_s = strtoul(tok + 5, NULL, 10);
+	} else if(tok[0] >= '0' && tok[0] <= '9' && tok[1] == 0) {
+		ev.code = k0 + (tok[0] - '0');
+		ev.scan = SCAN_DIGITS[tok[0] - '0'];
+	} else if(tok[0] >= 'A' && tok[0] <= 'Z' && tok[1] == 0) {
+		ev.code = kCapA + (tok[0] - 'A');
+		ev.scan = SCAN_LETTERS[tok[0] - 'A'];
+	} else {
+		for(i = 0; i < sizeof(KEY_NAMES)/sizeof(KEY_NAMES[0]); i++) {
+			if(strcmp(KEY_NAMES[i].name, tok) == 0) {
+				ev.code = KEY_NAMES[i].code;
+				ev.scan = KEY_NAMES[i].scan;
+			}
+		}
+		if(ev.code == 0) {
+			fprintf(stderr, "ERROR: Unknown key %s\n", tok);
+			exit(1);
+		}
+	}
+
+	emu->script = realloc(emu->script,
+			(emu->script_len + 1) * sizeof(struct event));
+	if(emu->script == NULL) {
+		perror("realloc");
+		exit(2);
+	}
+	emu->script[emu->script_len++] = ev;
+}
+
+/* Whitespace separated key names, # starts a comment */
+static void script_load(struct emu* emu, const char* file)
+{
+	FILE* fd;
+	char line[256];
+	char* tok;
+	char* hash;
+
+	if((fd = fopen(file, "r")) == NULL) {
+		perror(file);
+		exit(2);
+	}
+	while(fgets(line, sizeof(line), fd) != NULL) {
+		if((hash = strchr(line, '#')) != NULL)
+			*hash = 0;
+		for(tok = strtok(line, " \t\r\n"); tok != NULL;
+						tok = strtok(NULL, " \t\r\n"))
+			script_add(emu, tok);
+	}
+	fclose(fd);
+}
+
+/* -- Main -- */
+
+/*
+ * Restore the loaded program image and AppVars and forget all results, i.e.
+ * each run starts from the counters given with -a.
+ */
+static void restart(struct emu* emu, const unsigned char* image)
+{
+	size_t i;
+
+	free(emu->steps);
+	emu->steps = NULL;
+	emu->num_steps = 0;
+	emu->step_open = 0;
+	emu->script_pos = 0;
+	emu->idle_ns = 0;
+	emu->ticks = 0;
+	emu->halted = 0;
+	emu->halted_ticks = 0;
+	emu->speed = 0;
+	emu->interrupts = 0;
+	emu->waiting = 0;
+	emu->finished = 0;
+	memcpy(emu->mem, image, sizeof(emu->mem));
+
+	memcpy(emu->appvars, emu->initial_appvars, sizeof(emu->appvars));
+	emu->num_appvars = emu->num_initial_appvars;
+	emu->uservars_end = ADDR_USERVARS;
+	emu->flash_writes = 0;
+
+	for(i = 0; i < NUM_BCALLS; i++)
+		BCALLS[i].calls = 0;
+}
+
+/* z80_step, with calls and returns tracked for the profiler */
+static void exec(struct emu* emu)
+{
+	struct z80* cpu = &emu->cpu;
+	unsigned short pc = cpu->pc;
+	unsigned short sp = cpu->sp;
+	unsigned char op = emu->mem[pc];
+	unsigned cycles = z80_step(cpu);
+
+	if(emu->prof == NULL)
+		return;
+
+	profile_exec(emu->prof, pc, cycles);
+
+	if(cpu->sp == (unsigned short)(sp - 2)) {
+		/* CALL nn, CALL cc,nn, RST n except rst rBR_CALL */
+		if(op == 0xcd || (op & 0xc7) == 0xc4)
+			profile_call(emu->prof, cpu->pc, pc + 3, cpu->sp,
+							emu_busy(emu));
+		else if((op & 0xc7) == 0xc7 && op != 0xef)
+			profile_call(emu->prof, cpu->pc, pc + 1, cpu->sp,
+							emu_busy(emu));
+	} else {
+		profile_sp(emu->prof, cpu->sp, emu_busy(emu));
+	}
+}
+
+static void run(struct emu* emu)
+{
+	struct z80* cpu = &emu->cpu;
+	unsigned long long before;
+	unsigned long long cycles;
+	unsigned mult;
+
+	cpu->mem = emu->mem;
+	cpu->ctx = emu;
+	cpu->port_in = port_in;
+	cpu->port_out = port_out;
+	z80_reset(cpu);
+
+	cpu->sp = STACK_TOP;
+	cpu->iy = IY_FLAGS;
+	cpu->pc = START_ADDR;
+	cpu->im = 1;
+	cpu->iff1 = cpu->iff2 = 1;
+	z80_push(cpu, EXIT_ADDR);
+	screen_clear(emu);
+	step_begin(emu, NULL);
+	emu->next_irq = TICK_HZ / TIMER_HZ;
+
+	while(!emu->finished) {
+		/* speed changes take effect after the current instruction */
+		before = cpu->cycles;
+		mult = tick_mult(emu);
+
+		if(emu->ticks >= emu->next_irq) {
+			emu->next_irq += TICK_HZ / TIMER_HZ;
+			z80_irq(cpu);
+		}
+
+		if(cpu->halted) {
+			if(!cpu->iff1) {
+				fprintf(stderr, "ERROR: HALT with interrupts "
+					"disabled at PC=0x%04x\n", cpu->pc);
+				exit(2);
+			}
+			/* the program waits: unless in a WAIT, step is over */
+			if(!emu->waiting)
+				step_finish(emu);
+			if(emu->next_irq > emu->ticks) {
+				cycles = (emu->next_irq - emu->ticks +
+							mult - 1) / mult;
+				cpu->cycles += cycles;
+				emu->halted += cycles;
+				emu->halted_ticks += cycles * mult;
+			}
+		} else if(cpu->pc == ISR_VECTOR) {
+			/* OS interrupt handler: acknowledge, ei, ret */
+			emu->interrupts++;
+			cpu->cycles += emu->isr_cost;
+			cpu->pc = z80_pop(cpu);
+			cpu->iff1 = cpu->iff2 = 1;
+			if(emu->prof != NULL)
+				profile_pseudo(emu->prof, "[interrupt]",
+						cpu->pc, emu->isr_cost);
+		} else if(cpu->pc == BCALL_VECTOR) {
+			do_bcall(emu);
+		} else if(cpu->pc == EXIT_ADDR) {
+			wait_finish(emu);
+			step_finish(emu);
+			emu->finished = 2;
+		} else {
+			exec(emu);
+		}
+
+		emu->ticks += (cpu->cycles - before) * mult;
+
+		if(cpu->cycles > emu->max_cycles) {
+			fprintf(stderr, "ERROR: Exceeded %llu T-states at "
+					"PC=0x%04x\n", emu->max_cycles, cpu->pc);
+			exit(2);
+		}
+	}
+}
+
+static int report(struct emu* emu, int quiet, unsigned long long limit)
+{
+	size_t i;
+	int rv = 0;
+	struct step* s;
+
+	for(i = 0; i < emu->num_steps; i++) {
+		s = &emu->steps[i];
+		printf("[%2lu] %-9s %12llu T %10.3f ms %5.1f%% busy "
+			"%4lu bcalls%s\n", (unsigned long)i,
+			(s->ev == NULL) ? "(start)" : s->ev->name, s->cycles,
+			s->ticks * 1000.0 / TICK_HZ, (s->ticks == 0) ? 100.0 :
+			(s->busy_ticks * 100.0 / s->ticks), s->bcalls,
+			(limit != 0 && s->busy > limit) ? "  OVER LIMIT" : "");
+		if(!quiet)
+			screen_print(stdout, s->screen);
+		if(limit != 0 && s->busy > limit)
+			rv = 1;
+	}
+
+	printf("%s after %llu T-states, %.1f%% busy, %lu interrupts\n",
+		(emu->finished == 2) ? "Program exited" : "Script exhausted",
+		(unsigned long long)emu->cpu.cycles,
+		(emu->ticks - emu->halted_ticks) * 100.0 / emu->ticks,
+		emu->interrupts);
+
+	if(!quiet) {
+		puts("bcall        calls");
+		for(i = 0; i < NUM_BCALLS; i++)
+			if(BCALLS[i].calls != 0)
+				printf("%-12s %5lu\n", BCALLS[i].name,
+							BCALLS[i].calls);
+	}
+
+	return rv;
+}
+
+static unsigned long mem_u32(struct emu* emu, unsigned short addr)
+{
+	return emu->mem[addr] | (emu->mem[addr + 1] << 8) |
+			(emu->mem[addr + 2] << 16) |
+			((unsigned long)emu->mem[addr + 3] << 24);
+}
+
+static unsigned short mem_u16(struct emu* emu, unsigned short addr)
+{
+	return emu->mem[addr] | (emu->mem[addr + 1] << 8);
+}
+
+static const char* trace_name(unsigned short event, char* buf)
+{
+	static const char* EVENTS[] = { "?", "shs_transform", "hmac_sha1",
+						"hotp", "md5_compute" };
+	size_t i;
+
+	if(event < sizeof(EVENTS) / sizeof(char*))
+		return EVENTS[event];
+	for(i = 0; i < NUM_BCALLS; i++)
+		if(BCALLS[i].addr == event)
+			return BCALLS[i].name;
+	sprintf(buf, "0x%04x", event);
+	return buf;
+}
+
+/*
+ * Prints the counters and the last events the program traced, next to the
+ * bcalls counted by the emulator which should agree.
+ */
+static int report_trace(struct emu* emu)
+{
+	unsigned long next = mem_u32(emu, ADDR_TRACE + 2);
+	unsigned short addr;
+	unsigned short event;
+	unsigned long emulated;
+	unsigned long i;
+	size_t j;
+	char buf[8];
+
+	if(mem_u16(emu, ADDR_TRACE) != TRACE_MAGIC) {
+		fprintf(stderr, "ERROR: No trace found, compile with "
+						"TRACE=-DTRTOTP_TRACE\n");
+		return 2;
+	}
+
+	printf("Trace: %lu events\nevent           traced  emulated\n", next);
+	for(i = 0; i < TRACE_SLOTS; i++) {
+		addr = ADDR_TRACE + 10 + 6 * i;
+		if((event = mem_u16(emu, addr)) == 0)
+			break;
+		emulated = 0;
+		for(j = 0; j < NUM_BCALLS; j++)
+			if(BCALLS[j].addr == event)
+				emulated = BCALLS[j].calls;
+		printf("%-14s %7lu  ", trace_name(event, buf),
+						mem_u32(emu, addr + 2));
+		if(event >= FLASH_START)
+			printf("%8lu\n", emulated);
+		else
+			puts("       -");
+	}
+
+	puts("last events     s");
+	for(i = (next > TRACE_ENTRIES) ? (next - TRACE_ENTRIES) : 0; i < next;
+									i++) {
+		addr = ADDR_TRACE + 10 + 6 * TRACE_SLOTS +
+						4 * (i % TRACE_ENTRIES);
+		printf("%-14s %3u\n", trace_name(mem_u16(emu, addr), buf),
+						mem_u16(emu, addr + 2));
+	}
+	return 0;
+}
+
+/*
+ * Runs the script with the key derivation patched to 0 and to
+ * CALIBRATE_ITERATIONS iterations. The step whose busy time differs is the
+ * unlock, from the difference follows the cost per iteration and thus the
+ * number of iterations that fit into the given budget.
+ */
+static int calibrate(struct emu* emu, const unsigned char* image,
+				unsigned short addr, double budget_s)
+{
+	unsigned char patched[sizeof(emu->mem)];
+	unsigned long long* base;
+	unsigned long long diff = 0;
+	unsigned long long fixed = 0;
+	unsigned long long budget = (unsigned long long)(budget_s * TICK_HZ);
+	size_t num_base;
+	size_t i;
+	double per_iteration;
+	double iterations;
+
+	memcpy(patched, image, sizeof(patched));
+	patched[addr] = 0;
+	patched[addr + 1] = 0;
+	restart(emu, patched);
+	run(emu);
+
+	num_base = emu->num_steps;
+	base = malloc(num_base * sizeof(unsigned long long));
+	if(base == NULL) {
+		perror("malloc");
+		exit(2);
+	}
+	for(i = 0; i < num_base; i++)
+		base[i] = emu->steps[i].busy_ticks;
+
+	patched[addr] = CALIBRATE_ITERATIONS & 0xff;
+	patched[addr + 1] = CALIBRATE_ITERATIONS >> 8;
+	restart(emu, patched);
+	run(emu);
+
+	for(i = 0; i < num_base && i < emu->num_steps; i++) {
+		if(emu->steps[i].busy_ticks > base[i] &&
+				emu->steps[i].busy_ticks - base[i] > diff) {
+			diff = emu->steps[i].busy_ticks - base[i];
+			fixed = base[i];
+		}
+	}
+	free(base);
+
+	if(diff == 0) {
+		fprintf(stderr, "ERROR: Script does not unlock the program "
+				"or it does not read KDFITERATIONS\n");
+		return 1;
+	}
+
+	per_iteration = (double)diff / CALIBRATE_ITERATIONS;
+	printf("Unlock: %.3f ms fixed, %.3f ms per iteration\n",
+				fixed * 1000.0 / TICK_HZ,
+				per_iteration * 1000.0 / TICK_HZ);
+	if(fixed >= budget) {
+		printf("Budget of %.2f s is exceeded without iterations\n",
+								budget_s);
+		return 1;
+	}
+	iterations = (budget - fixed) / per_iteration;
+	if(iterations > MAX_ITERATIONS) {
+		printf("%.0f iterations would fit, capped to the maximum\n",
+								iterations);
+		iterations = MAX_ITERATIONS;
+	}
+	printf("iterations=%.0f fits into %.2f s on a %s\n", iterations,
+			budget_s, emu->model_83p ? "TI-83+" : "TI-84+");
+	return 0;
+}
+
+static void usage(const char* name)
+{
+	printf(
+"USAGE %s [-q6] [-u UNIXTIME] [-c BCALL=TSTATES] [-l LIMIT] [-m MAXCYCLES]\n"
+"       [-a APPVAR=FILE] [-s SCRIPT] [-y SYMBOLS [-p] [-C SECONDS]] [-T]\n"
+"       PROGRAM.8xp [KEY...]\n"
+"\n"
+"KEY is one of 0-9, A-Z, ENTER, DEL, CLEAR, UP, DOWN, LEFT, RIGHT or\n"
+"WAIT:n to let n seconds pass before the next key is pressed.\n"
+"\n"
+" -q  only print the step summary, no screens\n"
+" -6  model a TI-83+ which cannot switch to 15 MHz\n"
+" -u  time on the calculator clock as UNIX timestamp\n"
+" -c  model the given number of T-states for each call to BCALL\n"
+"     (ISR=TSTATES models the OS interrupt handler)\n"
+" -l  exit with status 1 if any step is busy for more than LIMIT T-states\n"
+" -m  abort after MAXCYCLES T-states in total\n"
+" -a  provide archived AppVar APPVAR with the contents of FILE and write\n"
+"     it back to FILE if the program archives it again, may be repeated\n"
+" -y  symbols (.noi, .map or .sym) of the program\n"
+" -p  print flat and call graph T-state profiles of the session (needs -y)\n"
+" -C  report how many key derivation iterations fit into SECONDS when\n"
+"     unlocking with the script's password (needs -y)\n"
+" -T  print the counters and events traced by a program compiled with\n"
+"     TRACE=-DTRTOTP_TRACE\n", name);
+}
+
+int main(int argc, char** argv)
+{
+	static struct emu emu;
+	static unsigned char image[sizeof(emu.mem)];
+	struct symtab symbols = { NULL, 0 };
+	const struct symbol* sym;
+	double budget_s = 0;
+	struct bcall* bc;
+	char* eq;
+	char* appvar[MAX_APPVARS];
+	char* appvar_file[MAX_APPVARS];
+	size_t num_appvar_files = 0;
+	size_t i;
+	int quiet = 0;
+	int profile = 0;
+	int trace = 0;
+	unsigned long long limit = 0;
+	int opt;
+	int rv;
+
+	emu.max_cycles = DEFAULT_MAX_CYCLES;
+	emu.clock_base = 0;
+
+	while((opt = getopt(argc, argv, "q6u:c:l:m:a:s:y:pC:Th")) != -1) {
+		switch(opt) {
+		case 'q':
+			quiet = 1;
+			break;
+		case '6':
+			emu.model_83p = 1;
+			break;
+		case 'u':
+			emu.clock_base = strtoul(optarg, NULL, 10) -
+								CLOCK_EPOCH;
+			break;
+		case 'c':
+			if((eq = strchr(optarg, '=')) == NULL) {
+				usage(argv[0]);
+				return 1;
+			}
+			*eq = 0;
+			if(strcmp(optarg, "ISR") == 0) {
+				emu.isr_cost = strtoul(eq + 1, NULL, 10);
+				break;
+			}
+			if((bc = bcall_by_name(optarg)) == NULL) {
+				fprintf(stderr, "ERROR: Unknown bcall %s\n",
+									optarg);
+				return 1;
+			}
+			bc->cost = strtoul(eq + 1, NULL, 10);
+			break;
+		case 'l':
+			limit = strtoull(optarg, NULL, 10);
+			break;
+		case 'm':
+			emu.max_cycles = strtoull(optarg, NULL, 10);
+			break;
+		case 'a':
+			if((eq = strchr(optarg, '=')) == NULL ||
+					num_appvar_files == MAX_APPVARS) {
+				usage(argv[0]);
+				return 1;
+			}
+			*eq = 0;
+			appvar[num_appvar_files] = optarg;
+			appvar_file[num_appvar_files++] = eq + 1;
+			break;
+		case 's':
+			script_load(&emu, optarg);
+			break;
+		case 'y':
+			if(symtab_load(&symbols, optarg) != 0)
+				return 2;
+			break;
+		case 'p':
+			profile = 1;
+			break;
+		case 'C':
+			budget_s = strtod(optarg, NULL);
+			break;
+		case 'T':
+			trace = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if(optind >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	emu.uservars_end = ADDR_USERVARS;
+	for(i = 0; i < num_appvar_files; i++)
+		appvar_load(&emu, appvar[i], appvar_file[i]);
+	load_program(&emu, argv[optind]);
+	for(optind++; optind < argc; optind++)
+		script_add(&emu, argv[optind]);
+
+	memcpy(image, emu.mem, sizeof(image));
+	memcpy(emu.initial_appvars, emu.appvars, sizeof(emu.appvars));
+	emu.num_initial_appvars = emu.num_appvars;
+
+	if(budget_s > 0) {
+		if((sym = symtab_by_name(&symbols, SYM_KDFITERATIONS)) ==
+									NULL) {
+			fprintf(stderr, "ERROR: Symbol %s not found, use -y\n",
+							SYM_KDFITERATIONS);
+			return 2;
+		}
+		return calibrate(&emu, image, sym->addr, budget_s);
+	}
+
+	if(profile) {
+		if(symbols.len == 0) {
+			fprintf(stderr, "ERROR: Profiling needs symbols, "
+								"use -y\n");
+			return 2;
+		}
+		emu.prof = profile_new(&symbols);
+	}
+
+	run(&emu);
+	rv = report(&emu, quiet, limit);
+	for(i = 0; i < num_appvar_files; i++)
+		appvar_save(&emu, appvar[i], appvar_file[i]);
+
+	if(emu.prof != NULL) {
+		putchar('\n');
+		profile_report(emu.prof, stdout);
+		profile_free(emu.prof);
+	}
+
+	if(trace) {
+		putchar('\n');
+		if(report_trace(&emu) != 0)
+			return 2;
+	}
+
+	return rv;
+}
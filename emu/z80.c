@@ -0,0 +1,885 @@
+/*
+ * Ma_Sys.ma TRTOTP Z80 Emulator Core 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Decoding follows the x/y/z/p/q scheme from "Decoding Z80 Opcodes"
+ * <http://www.z80.info/decoding.htm>. Undocumented flag bits 3 and 5 are
+ * not modelled.
+ */
+
+#include <string.h>
+
+#include "z80.h"
+
+#define FC  Z80_FLAG_C
+#define FN  Z80_FLAG_N
+#define FPV Z80_FLAG_PV
+#define FH  Z80_FLAG_H
+#define FZ  Z80_FLAG_Z
+#define FS  Z80_FLAG_S
+
+/* T-states of unprefixed opcodes (conditional branches: not taken) */
+static const uint8_t CYCLES_MAIN[256] = {
+	 4,10, 7, 6, 4, 4, 7, 4, 4,11, 7, 6, 4, 4, 7, 4,
+	 8,10, 7, 6, 4, 4, 7, 4,12,11, 7, 6, 4, 4, 7, 4,
+	 7,10,16, 6, 4, 4, 7, 4, 7,11,16, 6, 4, 4, 7, 4,
+	 7,10,13, 6,11,11,10, 4, 7,11,13, 6, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 7, 7, 7, 7, 7, 7, 4, 7, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 5,10,10,10,10,11, 7,11, 5,10,10, 0,10,17, 7,11,
+	 5,10,10,11,10,11, 7,11, 5, 4,10,11,10, 0, 7,11,
+	 5,10,10,19,10,11, 7,11, 5, 4,10, 4,10, 0, 7,11,
+	 5,10,10, 4,10,11, 7,11, 5, 6,10, 4,10, 0, 7,11,
+};
+
+static uint8_t parity(uint8_t v)
+{
+	v ^= v >> 4;
+	v ^= v >> 2;
+	v ^= v >> 1;
+	return (v & 1) ? 0 : FPV;
+}
+
+static uint8_t szp(uint8_t v)
+{
+	return (v & FS) | (v ? 0 : FZ) | parity(v);
+}
+
+/* -- Memory and Fetch -- */
+
+static uint8_t rd(struct z80* z, uint16_t addr)
+{
+	return z->mem[addr];
+}
+
+static void wr(struct z80* z, uint16_t addr, uint8_t val)
+{
+	z->mem[addr] = val;
+}
+
+static uint16_t rd16(struct z80* z, uint16_t addr)
+{
+	return rd(z, addr) | (rd(z, (uint16_t)(addr + 1)) << 8);
+}
+
+static void wr16(struct z80* z, uint16_t addr, uint16_t val)
+{
+	wr(z, addr, val & 0xff);
+	wr(z, (uint16_t)(addr + 1), val >> 8);
+}
+
+static uint8_t fetch(struct z80* z)
+{
+	return rd(z, z->pc++);
+}
+
+static uint16_t fetch16(struct z80* z)
+{
+	uint16_t v = rd16(z, z->pc);
+	z->pc += 2;
+	return v;
+}
+
+void z80_push(struct z80* z, uint16_t val)
+{
+	z->sp -= 2;
+	wr16(z, z->sp, val);
+}
+
+uint16_t z80_pop(struct z80* z)
+{
+	uint16_t v = rd16(z, z->sp);
+	z->sp += 2;
+	return v;
+}
+
+/* -- Register Access -- */
+
+static uint16_t get_bc(struct z80* z) { return (z->b << 8) | z->c; }
+static uint16_t get_de(struct z80* z) { return (z->d << 8) | z->e; }
+static uint16_t get_hl(struct z80* z) { return (z->h << 8) | z->l; }
+static void set_bc(struct z80* z, uint16_t v) { z->b = v >> 8; z->c = v; }
+static void set_de(struct z80* z, uint16_t v) { z->d = v >> 8; z->e = v; }
+static void set_hl(struct z80* z, uint16_t v) { z->h = v >> 8; z->l = v; }
+
+/* HL, IX or IY depending on the active prefix */
+static uint16_t get_xhl(struct z80* z)
+{
+	switch(z->pfx) {
+	case 1:  return z->ix;
+	case 2:  return z->iy;
+	default: return get_hl(z);
+	}
+}
+
+static void set_xhl(struct z80* z, uint16_t v)
+{
+	switch(z->pfx) {
+	case 1:  z->ix = v;     break;
+	case 2:  z->iy = v;     break;
+	default: set_hl(z, v);  break;
+	}
+}
+
+/* rp table: BC DE HL SP */
+static uint16_t get_rp(struct z80* z, int p)
+{
+	switch(p) {
+	case 0:  return get_bc(z);
+	case 1:  return get_de(z);
+	case 2:  return get_xhl(z);
+	default: return z->sp;
+	}
+}
+
+static void set_rp(struct z80* z, int p, uint16_t v)
+{
+	switch(p) {
+	case 0:  set_bc(z, v);  break;
+	case 1:  set_de(z, v);  break;
+	case 2:  set_xhl(z, v); break;
+	default: z->sp = v;     break;
+	}
+}
+
+/* rp2 table: BC DE HL AF */
+static uint16_t get_rp2(struct z80* z, int p)
+{
+	if(p == 3)
+		return (z->a << 8) | z->f;
+	return get_rp(z, p);
+}
+
+static void set_rp2(struct z80* z, int p, uint16_t v)
+{
+	if(p == 3) {
+		z->a = v >> 8;
+		z->f = v & 0xff;
+	} else {
+		set_rp(z, p, v);
+	}
+}
+
+/*
+ * r table: B C D E H L (HL) A. Index 6 must be handled by the caller.
+ * With a prefix active and idx set, H/L map to the index register halves.
+ */
+static uint8_t get_r(struct z80* z, int r, int idx)
+{
+	switch(r) {
+	case 0: return z->b;
+	case 1: return z->c;
+	case 2: return z->d;
+	case 3: return z->e;
+	case 4: return (idx && z->pfx) ? (get_xhl(z) >> 8) : z->h;
+	case 5: return (idx && z->pfx) ? (get_xhl(z) & 0xff) : z->l;
+	default: return z->a;
+	}
+}
+
+static void set_r(struct z80* z, int r, int idx, uint8_t v)
+{
+	switch(r) {
+	case 0: z->b = v; break;
+	case 1: z->c = v; break;
+	case 2: z->d = v; break;
+	case 3: z->e = v; break;
+	case 4:
+		if(idx && z->pfx)
+			set_xhl(z, (get_xhl(z) & 0x00ff) | (v << 8));
+		else
+			z->h = v;
+		break;
+	case 5:
+		if(idx && z->pfx)
+			set_xhl(z, (get_xhl(z) & 0xff00) | v);
+		else
+			z->l = v;
+		break;
+	default: z->a = v; break;
+	}
+}
+
+/* Address of (HL) or (IX+d)/(IY+d), fetches d if needed */
+static uint16_t addr_xhl(struct z80* z)
+{
+	if(z->pfx)
+		return (uint16_t)(get_xhl(z) + (int8_t)fetch(z));
+	return get_hl(z);
+}
+
+static int cond(struct z80* z, int y)
+{
+	switch(y) {
+	case 0:  return !(z->f & FZ);
+	case 1:  return  (z->f & FZ);
+	case 2:  return !(z->f & FC);
+	case 3:  return  (z->f & FC);
+	case 4:  return !(z->f & FPV);
+	case 5:  return  (z->f & FPV);
+	case 6:  return !(z->f & FS);
+	default: return  (z->f & FS);
+	}
+}
+
+/* -- Arithmetic -- */
+
+static uint8_t add8(struct z80* z, uint8_t a, uint8_t v, int carry)
+{
+	unsigned res = a + v + carry;
+	uint8_t r = res & 0xff;
+	z->f = (r & FS) | (r ? 0 : FZ) | ((a ^ v ^ r) & FH) |
+		((((a ^ ~v) & (a ^ r)) & 0x80) ? FPV : 0) |
+		((res > 0xff) ? FC : 0);
+	return r;
+}
+
+static uint8_t sub8(struct z80* z, uint8_t a, uint8_t v, int carry)
+{
+	int res = a - v - carry;
+	uint8_t r = res & 0xff;
+	z->f = (r & FS) | (r ? 0 : FZ) | ((a ^ v ^ r) & FH) |
+		((((a ^ v) & (a ^ r)) & 0x80) ? FPV : 0) | FN |
+		((res < 0) ? FC : 0);
+	return r;
+}
+
+static void alu(struct z80* z, int y, uint8_t v)
+{
+	switch(y) {
+	case 0: z->a = add8(z, z->a, v, 0);                  break;
+	case 1: z->a = add8(z, z->a, v, z->f & FC);          break;
+	case 2: z->a = sub8(z, z->a, v, 0);                  break;
+	case 3: z->a = sub8(z, z->a, v, z->f & FC);          break;
+	case 4: z->a &= v; z->f = szp(z->a) | FH;            break;
+	case 5: z->a ^= v; z->f = szp(z->a);                 break;
+	case 6: z->a |= v; z->f = szp(z->a);                 break;
+	default: sub8(z, z->a, v, 0);                        break;
+	}
+}
+
+static uint8_t inc8(struct z80* z, uint8_t v)
+{
+	uint8_t r = v + 1;
+	z->f = (z->f & FC) | (r & FS) | (r ? 0 : FZ) |
+		(((r & 0x0f) == 0) ? FH : 0) | ((r == 0x80) ? FPV : 0);
+	return r;
+}
+
+static uint8_t dec8(struct z80* z, uint8_t v)
+{
+	uint8_t r = v - 1;
+	z->f = (z->f & FC) | (r & FS) | (r ? 0 : FZ) | FN |
+		(((r & 0x0f) == 0x0f) ? FH : 0) | ((r == 0x7f) ? FPV : 0);
+	return r;
+}
+
+static uint16_t add16(struct z80* z, uint16_t a, uint16_t v)
+{
+	uint32_t res = a + v;
+	z->f = (z->f & (FS | FZ | FPV)) | (((a ^ v ^ res) >> 8) & FH) |
+		((res > 0xffff) ? FC : 0);
+	return res & 0xffff;
+}
+
+static uint16_t adc16(struct z80* z, uint16_t a, uint16_t v)
+{
+	uint32_t res = a + v + (z->f & FC);
+	uint16_t r = res & 0xffff;
+	z->f = ((r >> 8) & FS) | (r ? 0 : FZ) | (((a ^ v ^ r) >> 8) & FH) |
+		((((a ^ ~v) & (a ^ r)) & 0x8000) ? FPV : 0) |
+		((res > 0xffff) ? FC : 0);
+	return r;
+}
+
+static uint16_t sbc16(struct z80* z, uint16_t a, uint16_t v)
+{
+	int32_t res = (int32_t)a - v - (z->f & FC);
+	uint16_t r = res & 0xffff;
+	z->f = ((r >> 8) & FS) | (r ? 0 : FZ) | (((a ^ v ^ r) >> 8) & FH) |
+		((((a ^ v) & (a ^ r)) & 0x8000) ? FPV : 0) | FN |
+		((res < 0) ? FC : 0);
+	return r;
+}
+
+/* CB rotate/shift group: RLC RRC RL RR SLA SRA SLL SRL */
+static uint8_t rot(struct z80* z, int y, uint8_t v)
+{
+	uint8_t r;
+	uint8_t c;
+	switch(y) {
+	case 0:  c = v >> 7; r = (v << 1) | c;                   break;
+	case 1:  c = v & 1;  r = (v >> 1) | (c << 7);            break;
+	case 2:  c = v >> 7; r = (v << 1) | (z->f & FC);         break;
+	case 3:  c = v & 1;  r = (v >> 1) | ((z->f & FC) << 7);  break;
+	case 4:  c = v >> 7; r = v << 1;                         break;
+	case 5:  c = v & 1;  r = (v >> 1) | (v & 0x80);          break;
+	case 6:  c = v >> 7; r = (v << 1) | 1;                   break;
+	default: c = v & 1;  r = v >> 1;                         break;
+	}
+	z->f = szp(r) | c;
+	return r;
+}
+
+static void daa(struct z80* z)
+{
+	uint8_t corr = 0;
+	uint8_t carry = z->f & FC;
+	uint8_t a = z->a;
+
+	if((z->f & FH) || (a & 0x0f) > 9)
+		corr |= 0x06;
+	if(carry || a > 0x99) {
+		corr |= 0x60;
+		carry = FC;
+	}
+	if(z->f & FN) {
+		z->a = a - corr;
+		z->f = (z->f & FN) | ((((a & 0x0f) < (corr & 0x0f)) &&
+						(z->f & FH)) ? FH : 0);
+	} else {
+		z->a = a + corr;
+		z->f = ((a & 0x0f) > 9) ? FH : 0;
+	}
+	z->f |= szp(z->a) | carry;
+}
+
+/* -- Prefixed Groups -- */
+
+static unsigned exec_cb(struct z80* z)
+{
+	uint16_t addr = 0;
+	uint8_t op;
+	uint8_t v;
+	uint8_t res = 0;
+	int x, y, r;
+	int mem;
+
+	if(z->pfx) {
+		/* DD CB d op */
+		addr = (uint16_t)(get_xhl(z) + (int8_t)fetch(z));
+		op = fetch(z);
+		mem = 1;
+	} else {
+		op = fetch(z);
+		mem = ((op & 7) == 6);
+		if(mem)
+			addr = get_hl(z);
+	}
+
+	x = op >> 6;
+	y = (op >> 3) & 7;
+	r = op & 7;
+
+	v = mem ? rd(z, addr) : get_r(z, r, 0);
+
+	switch(x) {
+	case 0: res = rot(z, y, v);            break;
+	case 1:
+		z->f = (z->f & FC) | FH | ((v & (1 << y)) ? 0 : (FZ | FPV)) |
+				((y == 7 && (v & 0x80)) ? FS : 0);
+		if(z->pfx)
+			return 20;
+		return mem ? 12 : 8;
+	case 2: res = v & ~(1 << y);           break;
+	default: res = v | (1 << y);           break;
+	}
+
+	if(mem) {
+		wr(z, addr, res);
+		/* undocumented: DD CB also copies the result to a register */
+		if(z->pfx && r != 6)
+			set_r(z, r, 0, res);
+	} else {
+		set_r(z, r, 0, res);
+	}
+
+	if(z->pfx)
+		return 23;
+	return mem ? 15 : 8;
+}
+
+static unsigned exec_block(struct z80* z, int y, int zz)
+{
+	uint16_t hl = get_hl(z);
+	uint16_t de = get_de(z);
+	uint16_t bc = get_bc(z);
+	int dir = (y & 1) ? -1 : 1;   /* y = 4,6 increment; 5,7 decrement */
+	int rep = (y >= 6);
+	uint8_t v;
+
+	switch(zz) {
+	case 0: /* LDI LDD LDIR LDDR */
+		wr(z, de, rd(z, hl));
+		set_hl(z, hl + dir);
+		set_de(z, de + dir);
+		set_bc(z, --bc);
+		z->f = (z->f & (FS | FZ | FC)) | (bc ? FPV : 0);
+		if(rep && bc) {
+			z->pc -= 2;
+			return 21;
+		}
+		return 16;
+	case 1: /* CPI CPD CPIR CPDR */
+		v = rd(z, hl);
+		{
+			uint8_t c = z->f & FC;
+			uint8_t r = z->a - v;
+			set_hl(z, hl + dir);
+			set_bc(z, --bc);
+			z->f = c | FN | (r & FS) | (r ? 0 : FZ) |
+				((z->a ^ v ^ r) & FH) | (bc ? FPV : 0);
+			if(rep && bc && r) {
+				z->pc -= 2;
+				return 21;
+			}
+		}
+		return 16;
+	case 2: /* INI IND INIR INDR */
+		wr(z, hl, z->port_in(z->ctx, bc));
+		set_hl(z, hl + dir);
+		z->b--;
+		z->f = (z->f & FC) | FN | (z->b ? 0 : FZ);
+		if(rep && z->b) {
+			z->pc -= 2;
+			return 21;
+		}
+		return 16;
+	default: /* OUTI OUTD OTIR OTDR */
+		v = rd(z, hl);
+		z->b--;
+		z->port_out(z->ctx, get_bc(z), v);
+		set_hl(z, hl + dir);
+		z->f = (z->f & FC) | FN | (z->b ? 0 : FZ);
+		if(rep && z->b) {
+			z->pc -= 2;
+			return 21;
+		}
+		return 16;
+	}
+}
+
+static unsigned exec_ed(struct z80* z)
+{
+	uint8_t op = fetch(z);
+	int x = op >> 6;
+	int y = (op >> 3) & 7;
+	int zz = op & 7;
+	int p = y >> 1;
+	int q = y & 1;
+	uint8_t v;
+	uint16_t nn;
+
+	/* ED ignores any DD/FD prefix */
+	z->pfx = 0;
+
+	if(x == 2 && zz <= 3 && y >= 4)
+		return exec_block(z, y, zz);
+
+	if(x != 1)
+		return 8; /* NONI */
+
+	switch(zz) {
+	case 0: /* IN r,(C) */
+		v = z->port_in(z->ctx, get_bc(z));
+		if(y != 6)
+			set_r(z, y, 0, v);
+		z->f = (z->f & FC) | szp(v);
+		return 12;
+	case 1: /* OUT (C),r */
+		z->port_out(z->ctx, get_bc(z), (y == 6) ? 0 : get_r(z, y, 0));
+		return 12;
+	case 2:
+		if(q == 0)
+			set_hl(z, sbc16(z, get_hl(z), get_rp(z, p)));
+		else
+			set_hl(z, adc16(z, get_hl(z), get_rp(z, p)));
+		return 15;
+	case 3:
+		nn = fetch16(z);
+		if(q == 0)
+			wr16(z, nn, get_rp(z, p));
+		else
+			set_rp(z, p, rd16(z, nn));
+		return 20;
+	case 4: /* NEG */
+		z->a = sub8(z, 0, z->a, 0);
+		return 8;
+	case 5: /* RETN, RETI */
+		z->pc = z80_pop(z);
+		z->iff1 = z->iff2;
+		return 14;
+	case 6: /* IM */
+		{
+			static const uint8_t IM[8] = { 0, 0, 1, 2, 0, 0, 1, 2 };
+			z->im = IM[y];
+		}
+		return 8;
+	default:
+		switch(y) {
+		case 0: z->i = z->a; return 9;
+		case 1: z->r = z->a; return 9;
+		case 2:
+			z->a = z->i;
+			z->f = (z->f & FC) | (z->a & FS) | (z->a ? 0 : FZ) |
+						(z->iff2 ? FPV : 0);
+			return 9;
+		case 3:
+			z->a = z->r;
+			z->f = (z->f & FC) | (z->a & FS) | (z->a ? 0 : FZ) |
+						(z->iff2 ? FPV : 0);
+			return 9;
+		case 4: /* RRD */
+			v = rd(z, get_hl(z));
+			wr(z, get_hl(z), (z->a << 4) | (v >> 4));
+			z->a = (z->a & 0xf0) | (v & 0x0f);
+			z->f = (z->f & FC) | szp(z->a);
+			return 18;
+		case 5: /* RLD */
+			v = rd(z, get_hl(z));
+			wr(z, get_hl(z), (v << 4) | (z->a & 0x0f));
+			z->a = (z->a & 0xf0) | (v >> 4);
+			z->f = (z->f & FC) | szp(z->a);
+			return 18;
+		default:
+			return 8;
+		}
+	}
+}
+
+/* -- Main Decoder -- */
+
+static unsigned exec_main(struct z80* z, uint8_t op)
+{
+	int x = op >> 6;
+	int y = (op >> 3) & 7;
+	int zz = op & 7;
+	int p = y >> 1;
+	int q = y & 1;
+	unsigned cyc = CYCLES_MAIN[op];
+	uint16_t addr;
+	uint16_t nn;
+	uint8_t v;
+	int8_t d;
+
+	/* prefix overhead, (IX+d) forms pay extra for the displacement */
+	if(z->pfx)
+		cyc += 4;
+
+	switch(x) {
+	case 0:
+		switch(zz) {
+		case 0:
+			switch(y) {
+			case 0: break;
+			case 1:
+				v = z->a; z->a = z->a_; z->a_ = v;
+				v = z->f; z->f = z->f_; z->f_ = v;
+				break;
+			case 2: /* DJNZ */
+				d = (int8_t)fetch(z);
+				if(--z->b) {
+					z->pc += d;
+					cyc += 5;
+				}
+				break;
+			case 3: /* JR */
+				d = (int8_t)fetch(z);
+				z->pc += d;
+				break;
+			default: /* JR cc */
+				d = (int8_t)fetch(z);
+				if(cond(z, y - 4)) {
+					z->pc += d;
+					cyc += 5;
+				}
+				break;
+			}
+			break;
+		case 1:
+			if(q == 0)
+				set_rp(z, p, fetch16(z));
+			else
+				set_xhl(z, add16(z, get_xhl(z), get_rp(z, p)));
+			break;
+		case 2:
+			switch(y) {
+			case 0: wr(z, get_bc(z), z->a);             break;
+			case 1: z->a = rd(z, get_bc(z));            break;
+			case 2: wr(z, get_de(z), z->a);             break;
+			case 3: z->a = rd(z, get_de(z));            break;
+			case 4: wr16(z, fetch16(z), get_xhl(z));    break;
+			case 5: set_xhl(z, rd16(z, fetch16(z)));    break;
+			case 6: wr(z, fetch16(z), z->a);            break;
+			default: z->a = rd(z, fetch16(z));          break;
+			}
+			break;
+		case 3:
+			set_rp(z, p, get_rp(z, p) + (q ? -1 : 1));
+			break;
+		case 4:
+		case 5:
+			if(y == 6) {
+				addr = addr_xhl(z);
+				v = rd(z, addr);
+				wr(z, addr, (zz == 4) ? inc8(z, v) : dec8(z, v));
+				if(z->pfx)
+					cyc += 8;
+			} else {
+				v = get_r(z, y, 1);
+				set_r(z, y, 1, (zz == 4) ? inc8(z, v) : dec8(z, v));
+			}
+			break;
+		case 6:
+			if(y == 6) {
+				addr = addr_xhl(z);
+				wr(z, addr, fetch(z));
+				if(z->pfx)
+					cyc += 5;
+			} else {
+				set_r(z, y, 1, fetch(z));
+			}
+			break;
+		default:
+			switch(y) {
+			case 0: /* RLCA */
+				z->a = (z->a << 1) | (z->a >> 7);
+				z->f = (z->f & (FS | FZ | FPV)) | (z->a & FC);
+				break;
+			case 1: /* RRCA */
+				z->f = (z->f & (FS | FZ | FPV)) | (z->a & FC);
+				z->a = (z->a >> 1) | (z->a << 7);
+				break;
+			case 2: /* RLA */
+				v = z->a >> 7;
+				z->a = (z->a << 1) | (z->f & FC);
+				z->f = (z->f & (FS | FZ | FPV)) | v;
+				break;
+			case 3: /* RRA */
+				v = z->a & 1;
+				z->a = (z->a >> 1) | ((z->f & FC) << 7);
+				z->f = (z->f & (FS | FZ | FPV)) | v;
+				break;
+			case 4: daa(z); break;
+			case 5: /* CPL */
+				z->a = ~z->a;
+				z->f |= FH | FN;
+				break;
+			case 6: /* SCF */
+				z->f = (z->f & (FS | FZ | FPV)) | FC;
+				break;
+			default: /* CCF */
+				v = z->f & FC;
+				z->f = (z->f & (FS | FZ | FPV)) |
+						(v ? FH : FC);
+				break;
+			}
+			break;
+		}
+		break;
+	case 1:
+		if(y == 6 && zz == 6) {
+			z->halted = 1;
+		} else if(y == 6) {
+			/* LD (HL),r -- r refers to H/L even with prefix */
+			addr = addr_xhl(z);
+			wr(z, addr, get_r(z, zz, 0));
+			if(z->pfx)
+				cyc += 8;
+		} else if(zz == 6) {
+			addr = addr_xhl(z);
+			set_r(z, y, 0, rd(z, addr));
+			if(z->pfx)
+				cyc += 8;
+		} else {
+			set_r(z, y, 1, get_r(z, zz, 1));
+		}
+		break;
+	case 2:
+		if(zz == 6) {
+			alu(z, y, rd(z, addr_xhl(z)));
+			if(z->pfx)
+				cyc += 8;
+		} else {
+			alu(z, y, get_r(z, zz, 1));
+		}
+		break;
+	default:
+		switch(zz) {
+		case 0: /* RET cc */
+			if(cond(z, y)) {
+				z->pc = z80_pop(z);
+				cyc += 6;
+			}
+			break;
+		case 1:
+			if(q == 0) {
+				set_rp2(z, p, z80_pop(z));
+			} else {
+				switch(p) {
+				case 0: z->pc = z80_pop(z); break;
+				case 1:
+					v = z->b; z->b = z->b_; z->b_ = v;
+					v = z->c; z->c = z->c_; z->c_ = v;
+					v = z->d; z->d = z->d_; z->d_ = v;
+					v = z->e; z->e = z->e_; z->e_ = v;
+					v = z->h; z->h = z->h_; z->h_ = v;
+					v = z->l; z->l = z->l_; z->l_ = v;
+					break;
+				case 2: z->pc = get_xhl(z); break;
+				default: z->sp = get_xhl(z); break;
+				}
+			}
+			break;
+		case 2: /* JP cc */
+			nn = fetch16(z);
+			if(cond(z, y))
+				z->pc = nn;
+			break;
+		case 3:
+			switch(y) {
+			case 0: z->pc = fetch16(z); break;
+			case 1: break; /* CB is handled by z80_step */
+			case 2:
+				v = fetch(z);
+				z->port_out(z->ctx, (z->a << 8) | v, z->a);
+				break;
+			case 3:
+				v = fetch(z);
+				z->a = z->port_in(z->ctx, (z->a << 8) | v);
+				break;
+			case 4: /* EX (SP),HL */
+				nn = rd16(z, z->sp);
+				wr16(z, z->sp, get_xhl(z));
+				set_xhl(z, nn);
+				break;
+			case 5: /* EX DE,HL -- never affected by prefix */
+				nn = get_de(z);
+				set_de(z, get_hl(z));
+				set_hl(z, nn);
+				break;
+			case 6:
+				z->iff1 = z->iff2 = 0;
+				break;
+			default:
+				z->iff1 = z->iff2 = 1;
+				z->ei_delay = 1;
+				break;
+			}
+			break;
+		case 4: /* CALL cc */
+			nn = fetch16(z);
+			if(cond(z, y)) {
+				z80_push(z, z->pc);
+				z->pc = nn;
+				cyc += 7;
+			}
+			break;
+		case 5:
+			if(q == 0) {
+				z80_push(z, get_rp2(z, p));
+			} else if(p == 0) {
+				nn = fetch16(z);
+				z80_push(z, z->pc);
+				z->pc = nn;
+			}
+			/* prefixes are handled by z80_step */
+			break;
+		case 6:
+			alu(z, y, fetch(z));
+			break;
+		default:
+			z80_push(z, z->pc);
+			z->pc = y * 8;
+			break;
+		}
+		break;
+	}
+	return cyc;
+}
+
+void z80_reset(struct z80* z)
+{
+	uint8_t* mem = z->mem;
+	void* ctx = z->ctx;
+	uint8_t (*port_in)(void*, uint16_t) = z->port_in;
+	void (*port_out)(void*, uint16_t, uint8_t) = z->port_out;
+
+	memset(z, 0, sizeof(struct z80));
+	z->mem = mem;
+	z->ctx = ctx;
+	z->port_in = port_in;
+	z->port_out = port_out;
+	z->a = z->f = 0xff;
+	z->sp = 0xffff;
+}
+
+unsigned z80_step(struct z80* z)
+{
+	unsigned cyc = 0;
+	uint8_t op;
+
+	z->ei_delay = 0;
+
+	if(z->halted) {
+		z->cycles += 4;
+		return 4;
+	}
+
+	z->pfx = 0;
+	op = fetch(z);
+	z->r = (z->r & 0x80) | ((z->r + 1) & 0x7f);
+
+	/* a chain of DD/FD prefixes: the last one wins */
+	while(op == 0xdd || op == 0xfd) {
+		if(z->pfx)
+			cyc += 4;
+		z->pfx = (op == 0xdd) ? 1 : 2;
+		op = fetch(z);
+	}
+
+	if(op == 0xed) {
+		if(z->pfx)
+			cyc += 4;
+		cyc += exec_ed(z);
+	} else if(op == 0xcb) {
+		/* includes the cost of a single DD/FD prefix */
+		cyc += exec_cb(z);
+	} else {
+		cyc += exec_main(z, op);
+	}
+
+	z->pfx = 0;
+	z->cycles += cyc;
+	return cyc;
+}
+
+unsigned z80_irq(struct z80* z)
+{
+	uint16_t vec;
+
+	if(!z->iff1 || z->ei_delay)
+		return 0;
+
+	z->halted = 0;
+	z->iff1 = z->iff2 = 0;
+	z80_push(z, z->pc);
+
+	if(z->im == 2) {
+		vec = (z->i << 8) | 0xff;
+		z->pc = rd16(z, vec);
+		z->cycles += 19;
+		return 19;
+	}
+
+	z->pc = 0x38;
+	z->cycles += 13;
+	return 13;
+}
@@ -0,0 +1,53 @@
+/*
+ * Ma_Sys.ma TRTOTP Z80 Emulator Core 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Minimal Z80 interpreter with T-state accounting. Only what is needed to
+ * replay the trtotp program is modelled: documented instructions, the common
+ * undocumented IXH/IXL/IYH/IYL forms, interrupt mode 1/2 and HALT.
+ * Memory is a flat 64 KiB array, I/O is delegated to callbacks.
+ */
+
+#include <stdint.h>
+
+#define Z80_FLAG_C  0x01
+#define Z80_FLAG_N  0x02
+#define Z80_FLAG_PV 0x04
+#define Z80_FLAG_H  0x10
+#define Z80_FLAG_Z  0x40
+#define Z80_FLAG_S  0x80
+
+struct z80 {
+	uint8_t a, f, b, c, d, e, h, l;
+	uint8_t a_, f_, b_, c_, d_, e_, h_, l_; /* shadow registers */
+	uint16_t ix, iy, sp, pc;
+	uint8_t i, r, iff1, iff2, im;
+	uint8_t halted;
+	uint8_t ei_delay;   /* no interrupt directly after EI */
+
+	uint64_t cycles;    /* T-states executed so far */
+
+	uint8_t* mem;       /* 64 KiB */
+	void* ctx;          /* passed to the I/O callbacks */
+	uint8_t (*port_in)(void* ctx, uint16_t port);
+	void (*port_out)(void* ctx, uint16_t port, uint8_t val);
+
+	/* decoder state, only valid during z80_step */
+	uint8_t pfx;        /* 0: none, 1: DD (IX), 2: FD (IY) */
+};
+
+void z80_reset(struct z80* z);
+
+/* Execute one instruction (or one HALT cycle), returns T-states used */
+unsigned z80_step(struct z80* z);
+
+/*
+ * Raise a maskable interrupt. Returns T-states used or 0 if the interrupt
+ * was not accepted (interrupts disabled or directly after EI).
+ */
+unsigned z80_irq(struct z80* z);
+
+/* Stack helpers for use by trap handlers */
+void z80_push(struct z80* z, uint16_t val);
+uint16_t z80_pop(struct z80* z);
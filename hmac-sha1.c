@@ -25,39 +25,78 @@
  * Written by Simon Josefsson. 
  */
 
-#define IPAD_BYTE      0x36
-#define OPAD_BYTE      0x5c
 #define SHA1_BLOCKSIZE 64
 
 static void hmac_sha1(const void *key, unsigned char keylen, const void *in,
 					unsigned char inlen, void *resbuf)
 {
-	SHA_CTX inner;
-	SHA_CTX outer;
-	char block[SHA1_BLOCKSIZE];
-	char innerhash[20];
+	HMAC_CTX ctx;
 
 	/* Reduce the key's size, so that it becomes <= 64 bytes large.  */
 	if(keylen > SHA1_BLOCKSIZE)
 		return; /* NOT IMPLEMENTED */
 
-	/* Compute INNERHASH from KEY and IN. */
-	memset(block, IPAD_BYTE, SHA1_BLOCKSIZE);
-	memxor(block, key, keylen);
+	hmac_sha1_key(&ctx, key, keylen);
+	hmac_sha1_msg(&ctx, in, inlen, resbuf);
+}
+
+static void hmac_sha1_key(HMAC_CTX* ctx, const void* key, unsigned char keylen)
+{
+	hmac_sha1_pad(&ctx->inner, key, keylen, IPAD_BYTE);
+	hmac_sha1_pad(&ctx->outer, key, keylen, OPAD_BYTE);
+}
 
-	sha_init(&inner);
-	sha_update(&inner, block, SHA1_BLOCKSIZE);
-	sha_update(&inner, in, inlen);
-	sha_final(innerhash, &inner);
+static void hmac_sha1_pad(SHA_CTX* sha, const void* key, unsigned char keylen,
+							unsigned char pad)
+{
+	unsigned char block[SHA1_BLOCKSIZE];
 
-	/* Compute result from KEY and INNERHASH.  */
-	memset(block, OPAD_BYTE, SHA1_BLOCKSIZE);
+	memset(block, pad, SHA1_BLOCKSIZE);
 	memxor(block, key, keylen);
 
-	sha_init(&outer);
-	sha_update(&outer, block, SHA1_BLOCKSIZE);
-	sha_update(&outer, innerhash, 20);
-	sha_final(resbuf, &outer);
+	sha_init(sha);
+	sha_update(sha, block, SHA1_BLOCKSIZE);
+}
+
+static void hmac_sha1_midstate(SHA_CTX* sha, const void* state)
+{
+	memcpy(sha->digest, state, sizeof(sha->digest));
+	long_reverse(sha->digest, sizeof(sha->digest));
+	sha->countLo = SHA1_BLOCKSIZE * 8;
+	sha->countHi = 0;
+}
+
+static void hmac_sha1_msg(const HMAC_CTX* ctx, const void* in,
+					unsigned char inlen, void* resbuf)
+{
+	char innerhash[20];
+
+	hmac_sha1_inner(ctx, in, inlen, innerhash);
+	hmac_sha1_outer(ctx, innerhash, resbuf);
+}
+
+/* Compute INNERHASH from KEY and IN. */
+static void hmac_sha1_inner(const HMAC_CTX* ctx, const void* in,
+					unsigned char inlen, void* innerhash)
+{
+	SHA_CTX sha;
+
+	memcpy(&sha, &ctx->inner, sizeof(SHA_CTX));
+	sha_update(&sha, in, inlen);
+	sha_final(innerhash, &sha);
+}
+
+/* Compute result from KEY and INNERHASH.  */
+static void hmac_sha1_outer(const HMAC_CTX* ctx, const void* innerhash,
+							void* resbuf)
+{
+	SHA_CTX sha;
+
+	TRACE(TRACE_HMAC);
+
+	memcpy(&sha, &ctx->outer, sizeof(SHA_CTX));
+	sha_update(&sha, innerhash, 20);
+	sha_final(resbuf, &sha);
 }
 
 static void memxor(void* dest, const void* src, unsigned char n)
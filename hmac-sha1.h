@@ -1,5 +1,8 @@
 static void memxor(void* dest, const void* src, unsigned char n);
 
+#define IPAD_BYTE      0x36
+#define OPAD_BYTE      0x5c
+
 /*
  * Generate the HMAC SHA1 digest of message "in" (whose length is "keylen"),
  * using the specified "key" (whose length is "inlen"),
@@ -7,3 +10,36 @@ static void memxor(void* dest, const void* src, unsigned char n);
  */
 static void hmac_sha1(const void* key, unsigned char keylen, const void* in,
 					unsigned char inlen, void* resbuf);
+
+/*
+ * Split version for many messages with the same key: hmac_sha1_key hashes
+ * the key blocks once, each hmac_sha1_msg then needs only two SHA-1 blocks
+ * (for messages up to 55 bytes) instead of four.
+ */
+typedef struct {
+	SHA_CTX inner;                    /* after the key ^ ipad block */
+	SHA_CTX outer;                    /* after the key ^ opad block */
+} HMAC_CTX;
+
+static void hmac_sha1_key(HMAC_CTX* ctx, const void* key, unsigned char keylen);
+static void hmac_sha1_msg(const HMAC_CTX* ctx, const void* in,
+					unsigned char inlen, void* resbuf);
+
+/*
+ * The same in steps of one SHA-1 block each for callers that need to do
+ * other work in between: hmac_sha1_pad with IPAD_BYTE into ctx->inner and
+ * OPAD_BYTE into ctx->outer replaces hmac_sha1_key, hmac_sha1_inner then
+ * hmac_sha1_outer (innerhash and resbuf may be the same) hmac_sha1_msg.
+ */
+static void hmac_sha1_pad(SHA_CTX* sha, const void* key, unsigned char keylen,
+							unsigned char pad);
+static void hmac_sha1_inner(const HMAC_CTX* ctx, const void* in,
+					unsigned char inlen, void* innerhash);
+static void hmac_sha1_outer(const HMAC_CTX* ctx, const void* innerhash,
+							void* resbuf);
+
+/*
+ * Instead of hmac_sha1_pad: Sets sha to a state computed elsewhere, given as
+ * the five chaining values in big endian byte order (20 bytes).
+ */
+static void hmac_sha1_midstate(SHA_CTX* sha, const void* state);
@@ -0,0 +1,34 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Crypto 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <string.h>
+
+#include "calc_crypto.h"
+
+/* UINT4 is uint32_t instead of the calculator's 32 bit unsigned long */
+#define TRTOTP_HOST
+
+#include "../sha1.h"
+#include "../hmac-sha1.h"
+#include "../hotp.h"
+#include "../trace.h"  /* without TRTOTP_TRACE: no counters */
+
+#include "../sha1.c"
+#include "../hmac-sha1.c"
+#include "../hotp.c"
+
+uint32_t calc_hotp(const unsigned char* key, unsigned char keylen,
+				uint32_t counter, unsigned char digits)
+{
+	UINT4 out;
+	hotp(key, keylen, counter, digits, &out);
+	return out;
+}
@@ -0,0 +1,15 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Crypto 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * The calculator's sha1.c, hmac-sha1.c and hotp.c compiled for the host as
+ * reference for the batch implementation. Not thread safe: shs_transform
+ * keeps its working variables in static storage.
+ */
+
+#include <stdint.h>
+
+/* hotp() of ../hotp.c */
+uint32_t calc_hotp(const unsigned char* key, unsigned char keylen,
+				uint32_t counter, unsigned char digits);
@@ -0,0 +1,109 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Hash Lanes 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * The scalar variant is instantiated here, the vector ones in
+ * sha1x_*.c and md5x_*.c which are compiled with their instruction sets.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <strings.h>
+
+#include "hashx.h"
+
+/* -- Scalar Lanes -- */
+
+#define SHA1X_NAME  sha1x_scalar
+#define SHA1X_LANES 1
+#define MD5X_NAME   md5x_scalar
+#define MD5X_LANES  1
+
+#define V           uint32_t
+#define LOAD(p)     (*(p))
+#define STORE(p, x) (*(p) = (x))
+#define SET1(k)     ((uint32_t)(k))
+#define ADD(x, y)   ((x) + (y))
+#define XOR(x, y)   ((x) ^ (y))
+#define ROL(x, n)   (((x) << (n)) | ((x) >> (32 - (n))))
+#define F1(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define F2(b, c, d) ((b) ^ (c) ^ (d))
+#define F3(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+#define FI(b, c, d) ((c) ^ ((b) | ~(d)))
+
+static void sha1x_scalar(uint32_t* state, const uint32_t* block);
+static void md5x_scalar(uint32_t* state, const uint32_t* block);
+
+#include "sha1x.h"
+#include "md5x.h"
+
+/* -- Selection -- */
+
+#ifdef HOTP_BATCH_X86
+void sha1x_sse2(uint32_t* state, const uint32_t* block);
+void sha1x_avx2(uint32_t* state, const uint32_t* block);
+void sha1x_avx512(uint32_t* state, const uint32_t* block);
+void md5x_sse2(uint32_t* state, const uint32_t* block);
+void md5x_avx2(uint32_t* state, const uint32_t* block);
+void md5x_avx512(uint32_t* state, const uint32_t* block);
+
+static int has_sse2()
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+static int has_avx2()
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static int has_avx512()
+{
+	return __builtin_cpu_supports("avx512f");
+}
+#endif
+
+const struct hashx_impl HASHX_IMPLS[] = {
+#ifdef HOTP_BATCH_X86
+	{ "avx512", 16, md5x_avx512, sha1x_avx512, has_avx512 },
+	{ "avx2",    8, md5x_avx2,   sha1x_avx2,   has_avx2   },
+	{ "sse2",    4, md5x_sse2,   sha1x_sse2,   has_sse2   },
+#endif
+	{ "scalar",  1, md5x_scalar, sha1x_scalar, NULL       },
+};
+
+const size_t HASHX_NUM_IMPLS = sizeof(HASHX_IMPLS) /
+						sizeof(struct hashx_impl);
+
+static int hashx_supported(const struct hashx_impl* im)
+{
+#ifdef HOTP_BATCH_X86
+	__builtin_cpu_init();
+#endif
+	return im->supported == NULL || im->supported();
+}
+
+const struct hashx_impl* hashx_best()
+{
+	size_t i;
+
+	for(i = 0; i < HASHX_NUM_IMPLS - 1; i++)
+		if(hashx_supported(HASHX_IMPLS + i))
+			return HASHX_IMPLS + i;
+	return HASHX_IMPLS + HASHX_NUM_IMPLS - 1;
+}
+
+const struct hashx_impl* hashx_find(const char* name)
+{
+	size_t i;
+
+	for(i = 0; i < HASHX_NUM_IMPLS; i++)
+		if(strcasecmp(HASHX_IMPLS[i].name, name) == 0)
+			return hashx_supported(HASHX_IMPLS + i) ?
+						(HASHX_IMPLS + i) : NULL;
+	return NULL;
+}
@@ -0,0 +1,38 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Hash Lanes 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * The MD5 and SHA-1 lane implementations (md5x.h, sha1x.h) per instruction
+ * set and their selection at runtime, shared by hotp_batch.c and
+ * pad_bench.c. The lane functions are thread safe.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* one compression per lane, see sha1x.h for the data layout */
+typedef void (*hashx_fn)(uint32_t* state, const uint32_t* block);
+
+struct hashx_impl {
+	const char* name;
+	unsigned lanes;
+	hashx_fn md5x;
+	hashx_fn sha1x;
+	int (*supported)();  /* NULL: always */
+};
+
+/* in order of preference, the last one is "scalar" */
+extern const struct hashx_impl HASHX_IMPLS[];
+extern const size_t HASHX_NUM_IMPLS;
+
+#define HASHX_MAXLANES 16
+
+/* The best implementation supported by the CPU */
+const struct hashx_impl* hashx_best();
+
+/*
+ * The implementation called name ("scalar", "sse2", "avx2" or "avx512"),
+ * NULL if there is none by that name or the CPU does not support it.
+ */
+const struct hashx_impl* hashx_find(const char* name);
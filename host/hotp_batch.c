@@ -0,0 +1,206 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Batch HOTP 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Jobs are processed in groups of as many as the implementation has lanes,
+ * the last group is filled up by repeating the last job. Message blocks are
+ * the same as built by hmac_sha1_msg for an 8 byte message (inner) and the
+ * 20 byte inner hash (outer), hence only words 0-5 and 15 vary.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "hotp_batch.h"
+#include "hashx.h"
+
+#define MAXLANES       HASHX_MAXLANES
+#define SHA1_BLOCKSIZE 64
+
+/* as in ../hmac-sha1.h */
+#define IPAD_BYTE      0x36
+#define OPAD_BYTE      0x5c
+
+/* 64 bytes key block plus the message, in bits */
+#define INNER_BITS     ((SHA1_BLOCKSIZE + 8) * 8)
+#define OUTER_BITS     ((SHA1_BLOCKSIZE + 20) * 8)
+
+static const uint32_t SHA1_IV[5] = {
+	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+/* -- Implementation Selection -- */
+
+static const struct hashx_impl* impl_cur = NULL;
+static pthread_once_t impl_once = PTHREAD_ONCE_INIT;
+
+static void impl_init()
+{
+	impl_cur = hashx_best();
+}
+
+/* atomic: hotp_batch_select may run while other threads compute */
+static const struct hashx_impl* impl_get()
+{
+	pthread_once(&impl_once, impl_init);
+	return __atomic_load_n(&impl_cur, __ATOMIC_ACQUIRE);
+}
+
+const char* hotp_batch_impl()
+{
+	return impl_get()->name;
+}
+
+unsigned hotp_batch_lanes()
+{
+	return impl_get()->lanes;
+}
+
+int hotp_batch_select(const char* name)
+{
+	const struct hashx_impl* im = hashx_find(name);
+
+	if(im == NULL)
+		return 0;
+	impl_get();
+	__atomic_store_n(&impl_cur, im, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/* -- HOTP -- */
+
+/* Byte k of the big endian digest in lane l */
+static unsigned char digest_byte(const uint32_t* state, unsigned lanes,
+						unsigned l, unsigned k)
+{
+	return (state[(k / 4) * lanes + l] >> (24 - 8 * (k % 4))) & 0xff;
+}
+
+/* RFC 4226 dynamic truncation, as hotp_outer */
+static uint32_t truncate_code(const uint32_t* state, unsigned lanes,
+					unsigned l, unsigned char digits)
+{
+	unsigned offset = state[4 * lanes + l] & 0xf;
+	uint32_t bin_code =
+		(uint32_t)(digest_byte(state, lanes, l, offset) & 0x7f) << 24 |
+		(uint32_t)digest_byte(state, lanes, l, offset + 1) << 16 |
+		(uint32_t)digest_byte(state, lanes, l, offset + 2) <<  8 |
+		(uint32_t)digest_byte(state, lanes, l, offset + 3);
+
+	/* branch free, digits often differ between neighbouring jobs */
+	uint32_t mod6 = bin_code % 1000000;
+	uint32_t mod7 = bin_code % 10000000;
+	uint32_t mod8 = bin_code % 100000000;
+
+	return (digits == 8) ? mod8 : (digits == 7) ? mod7 : mod6;
+}
+
+void hotp_batch_key(struct hotp_key* out, const unsigned char* const* keys,
+					const unsigned char* keylens, size_t n)
+{
+	const struct hashx_impl* im = impl_get();
+	const unsigned lanes = im->lanes;
+	uint32_t inner[5 * MAXLANES];
+	uint32_t outer[5 * MAXLANES];
+	uint32_t iblock[16 * MAXLANES];
+	uint32_t oblock[16 * MAXLANES];
+	unsigned char ipad[SHA1_BLOCKSIZE];
+	unsigned char opad[SHA1_BLOCKSIZE];
+	size_t i;
+	size_t job;
+	unsigned l;
+	unsigned w;
+	unsigned k;
+
+	for(i = 0; i < n; i += lanes) {
+		for(l = 0; l < lanes; l++) {
+			job = (i + l < n) ? (i + l) : (n - 1);
+			memset(ipad, IPAD_BYTE, SHA1_BLOCKSIZE);
+			memset(opad, OPAD_BYTE, SHA1_BLOCKSIZE);
+			for(k = 0; k < keylens[job]; k++) {
+				ipad[k] ^= keys[job][k];
+				opad[k] ^= keys[job][k];
+			}
+			for(w = 0; w < 16; w++) {
+				iblock[w * lanes + l] =
+					(uint32_t)ipad[4 * w] << 24 |
+					(uint32_t)ipad[4 * w + 1] << 16 |
+					(uint32_t)ipad[4 * w + 2] << 8 |
+					(uint32_t)ipad[4 * w + 3];
+				oblock[w * lanes + l] =
+					(uint32_t)opad[4 * w] << 24 |
+					(uint32_t)opad[4 * w + 1] << 16 |
+					(uint32_t)opad[4 * w + 2] << 8 |
+					(uint32_t)opad[4 * w + 3];
+			}
+			for(w = 0; w < 5; w++)
+				inner[w * lanes + l] = outer[w * lanes + l] =
+								SHA1_IV[w];
+		}
+
+		im->sha1x(inner, iblock);
+		im->sha1x(outer, oblock);
+
+		for(l = 0; l < lanes && i + l < n; l++) {
+			for(w = 0; w < 5; w++) {
+				out[i + l].inner[w] = inner[w * lanes + l];
+				out[i + l].outer[w] = outer[w * lanes + l];
+			}
+		}
+	}
+}
+
+void hotp_batch(uint32_t* codes, const struct hotp_job* jobs, size_t n)
+{
+	const struct hashx_impl* im = impl_get();
+	const unsigned lanes = im->lanes;
+	uint32_t inner[5 * MAXLANES];
+	uint32_t outer[5 * MAXLANES];
+	uint32_t block[16 * MAXLANES];
+	const struct hotp_job* job;
+	size_t i;
+	unsigned l;
+	unsigned w;
+
+	/* words 6-14 are always 0 */
+	memset(block, 0, sizeof(block));
+
+	for(i = 0; i < n; i += lanes) {
+		for(l = 0; l < lanes; l++) {
+			job = jobs + ((i + l < n) ? (i + l) : (n - 1));
+			for(w = 0; w < 5; w++) {
+				inner[w * lanes + l] = job->key->inner[w];
+				outer[w * lanes + l] = job->key->outer[w];
+			}
+			/* counter, padding, message length */
+			block[0 * lanes + l] = 0;
+			block[1 * lanes + l] = job->counter;
+			block[2 * lanes + l] = 0x80000000;
+			block[3 * lanes + l] = 0;
+			block[4 * lanes + l] = 0;
+			block[5 * lanes + l] = 0;
+			block[15 * lanes + l] = INNER_BITS;
+		}
+
+		im->sha1x(inner, block);
+
+		/* inner hash, padding, message length */
+		memcpy(block, inner, 5 * lanes * sizeof(uint32_t));
+		for(l = 0; l < lanes; l++) {
+			block[5 * lanes + l] = 0x80000000;
+			block[15 * lanes + l] = OUTER_BITS;
+		}
+
+		im->sha1x(outer, block);
+
+		for(l = 0; l < lanes && i + l < n; l++)
+			codes[i + l] = truncate_code(outer, lanes, l,
+							jobs[i + l].digits);
+	}
+}
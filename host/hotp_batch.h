@@ -0,0 +1,47 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Batch HOTP 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * HOTP (and hence TOTP) for many key/counter pairs at once with the same
+ * semantics as hotp() in ../hotp.c: keys of up to 64 bytes, 32 bit
+ * counters (upper half of the 8 byte message is 0) and 6 digits unless 7
+ * or 8 are requested. Independent SHA-1 compressions run in parallel lanes,
+ * 4 with SSE2, 8 with AVX2 and 16 with AVX-512, selected at runtime.
+ * All functions are thread safe.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* HMAC-SHA1 state after the key blocks, see hmac_sha1_key */
+struct hotp_key {
+	uint32_t inner[5];
+	uint32_t outer[5];
+};
+
+struct hotp_job {
+	const struct hotp_key* key;
+	uint32_t counter;
+	unsigned char digits;
+};
+
+/* Two SHA-1 compressions per key, keys[i] has keylens[i] <= 64 bytes */
+void hotp_batch_key(struct hotp_key* out, const unsigned char* const* keys,
+					const unsigned char* keylens, size_t n);
+
+/* Two SHA-1 compressions per job */
+void hotp_batch(uint32_t* codes, const struct hotp_job* jobs, size_t n);
+
+/*
+ * Implementation in use: "scalar", "sse2", "avx2" or "avx512". The best one
+ * supported by the CPU is chosen on first use. hotp_batch_select switches
+ * to the given one and returns 0 if it is not available. Calls already
+ * running in other threads finish with the previous one, hence select
+ * before starting threads if hotp_batch_lanes is used to size batches.
+ */
+const char* hotp_batch_impl();
+int hotp_batch_select(const char* name);
+
+/* Number of lanes of the implementation in use */
+unsigned hotp_batch_lanes();
@@ -0,0 +1,198 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Batch HOTP Benchmark 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Compares hotp_batch in all implementations the CPU supports against the
+ * calculator's hotp() compiled for the host (calc_crypto.c). All codes are
+ * checked against the latter. Single threaded, i.e. rates are per core.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "calc_crypto.h"
+#include "hotp_batch.h"
+
+#define DEFAULT_JOBS    (1 << 20)
+#define DEFAULT_KEYS    4096
+#define DEFAULT_SECONDS 1.0
+#define KEYLEN          20
+
+static const char* IMPL_NAMES[] = { "scalar", "sse2", "avx2", "avx512" };
+
+#define NUM_IMPL_NAMES (sizeof(IMPL_NAMES)/sizeof(char*))
+
+static double now_s()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* deterministic such that runs are comparable, xorshift32 */
+static uint32_t rnd()
+{
+	static uint32_t x = 0x2545f491;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static void usage(const char* name)
+{
+	printf(
+"USAGE %s [-n JOBS] [-k KEYS] [-s SECONDS] [-i IMPL]\n"
+"\n"
+" -n  number of key/counter pairs per hotp_batch call\n"
+" -k  number of distinct 20 byte keys\n"
+" -s  minimum time to measure each implementation\n"
+" -i  only measure IMPL (scalar, sse2, avx2 or avx512)\n", name);
+}
+
+int main(int argc, char** argv)
+{
+	size_t num_jobs = DEFAULT_JOBS;
+	size_t num_keys = DEFAULT_KEYS;
+	double seconds = DEFAULT_SECONDS;
+	const char* only = NULL;
+	unsigned char* keydata;
+	unsigned char** keys;
+	unsigned char* keylens;
+	struct hotp_key* hkeys;
+	struct hotp_job* jobs;
+	uint32_t* expect;
+	uint32_t* codes;
+	size_t num_check;
+	size_t i;
+	size_t runs;
+	double t0;
+	double t;
+	double port_rate;
+	double key_rate;
+	double code_rate;
+	int opt;
+	int rv = 0;
+
+	while((opt = getopt(argc, argv, "n:k:s:i:h")) != -1) {
+		switch(opt) {
+		case 'n': num_jobs = strtoul(optarg, NULL, 10); break;
+		case 'k': num_keys = strtoul(optarg, NULL, 10); break;
+		case 's': seconds = strtod(optarg, NULL);       break;
+		case 'i': only = optarg;                         break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(num_jobs == 0 || num_keys == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	keydata = malloc(num_keys * KEYLEN);
+	keys    = malloc(num_keys * sizeof(unsigned char*));
+	keylens = malloc(num_keys);
+	hkeys   = malloc(num_keys * sizeof(struct hotp_key));
+	jobs    = malloc(num_jobs * sizeof(struct hotp_job));
+	expect  = malloc(num_jobs * sizeof(uint32_t));
+	codes   = malloc(num_jobs * sizeof(uint32_t));
+	if(keydata == NULL || keys == NULL || keylens == NULL ||
+				hkeys == NULL || jobs == NULL ||
+				expect == NULL || codes == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return 2;
+	}
+
+	for(i = 0; i < num_keys * KEYLEN; i++)
+		keydata[i] = rnd();
+	for(i = 0; i < num_keys; i++) {
+		keys[i] = keydata + i * KEYLEN;
+		keylens[i] = KEYLEN;
+	}
+	for(i = 0; i < num_jobs; i++) {
+		jobs[i].key = hkeys + (rnd() % num_keys);
+		jobs[i].counter = rnd();
+		jobs[i].digits = 6 + i % 3;
+	}
+
+	/* reference: the calculator code, key setup included */
+	num_check = 0;
+	t0 = now_s();
+	do {
+		i = jobs[num_check].key - hkeys;
+		expect[num_check] = calc_hotp(keys[i], keylens[i],
+				jobs[num_check].counter, jobs[num_check].digits);
+		num_check++;
+	} while(num_check < num_jobs && ((num_check & 1023) != 0 ||
+						now_s() - t0 < seconds));
+	t = now_s() - t0;
+	port_rate = num_check / t;
+
+	printf("%-8s %5s %12s %12s %12s %8s\n", "impl", "lanes",
+			"keys/s", "codes/s", "full/s", "speedup");
+	printf("%-8s %5u %12s %12s %12.0f %7.1fx\n", "port", 1, "-", "-",
+							port_rate, 1.0);
+
+	for(i = 0; i < NUM_IMPL_NAMES; i++) {
+		if(only != NULL && strcmp(only, IMPL_NAMES[i]) != 0)
+			continue;
+		if(!hotp_batch_select(IMPL_NAMES[i])) {
+			printf("%-8s (not supported)\n", IMPL_NAMES[i]);
+			continue;
+		}
+
+		/* key setup */
+		runs = 0;
+		t0 = now_s();
+		do {
+			hotp_batch_key(hkeys, (const unsigned char* const*)keys,
+							keylens, num_keys);
+			runs++;
+		} while((t = now_s() - t0) < seconds);
+		key_rate = runs * num_keys / t;
+
+		/* codes with cached keys */
+		runs = 0;
+		t0 = now_s();
+		do {
+			hotp_batch(codes, jobs, num_jobs);
+			runs++;
+		} while((t = now_s() - t0) < seconds);
+		code_rate = runs * num_jobs / t;
+
+		if(memcmp(codes, expect, num_check * sizeof(uint32_t)) != 0) {
+			printf("%-8s MISMATCH with the calculator code\n",
+								IMPL_NAMES[i]);
+			rv = 1;
+			continue;
+		}
+
+		/* a new key for each code */
+		t = 1 / (1 / key_rate + 1 / code_rate);
+		printf("%-8s %5u %12.0f %12.0f %12.0f %7.1fx\n", IMPL_NAMES[i],
+				hotp_batch_lanes(), key_rate, code_rate, t,
+				code_rate / port_rate);
+	}
+
+	printf("%lu codes checked against the calculator code\n",
+						(unsigned long)num_check);
+
+	free(keydata);
+	free(keys);
+	free(keylens);
+	free(hkeys);
+	free(jobs);
+	free(expect);
+	free(codes);
+	return rv;
+}
@@ -0,0 +1,77 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Latency Histogram 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Values below LATENCY_SUB have a bucket each. Above, bucket
+ * (e - 3) * 16 + m holds values with highest bit e and the next four bits m.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <time.h>
+
+#include "latency.h"
+
+uint64_t latency_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static unsigned bucket_of(uint64_t ns)
+{
+	unsigned e;
+
+	if(ns < LATENCY_SUB)
+		return (unsigned)ns;
+	e = 63 - __builtin_clzll(ns);
+	return (e - 3) * LATENCY_SUB + ((ns >> (e - 4)) & (LATENCY_SUB - 1));
+}
+
+static uint64_t bucket_low(unsigned b)
+{
+	unsigned e;
+
+	if(b < LATENCY_SUB)
+		return b;
+	e = b / LATENCY_SUB + 3;
+	return (uint64_t)(LATENCY_SUB + b % LATENCY_SUB) << (e - 4);
+}
+
+void latency_add(struct latency* h, uint64_t ns, uint64_t weight)
+{
+	h->bucket[bucket_of(ns)] += weight;
+	h->count += weight;
+	if(ns > h->max)
+		h->max = ns;
+}
+
+void latency_merge(struct latency* dst, const struct latency* src)
+{
+	unsigned i;
+
+	for(i = 0; i < LATENCY_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+	dst->count += src->count;
+	if(src->max > dst->max)
+		dst->max = src->max;
+}
+
+uint64_t latency_percentile(const struct latency* h, double q)
+{
+	uint64_t want = (uint64_t)(q * h->count);
+	uint64_t sum = 0;
+	unsigned i;
+
+	for(i = 0; i < LATENCY_BUCKETS; i++) {
+		sum += h->bucket[i];
+		if(sum > want)
+			return bucket_low(i);
+	}
+	return h->max;
+}
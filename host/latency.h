@@ -0,0 +1,31 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Latency Histogram 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Log-linear histogram of nanosecond values: 16 buckets per power of two,
+ * i.e. percentiles are accurate to about 6%, in constant memory. Not thread
+ * safe, use one per thread and latency_merge them.
+ */
+
+#include <stdint.h>
+
+#define LATENCY_SUB     16
+#define LATENCY_BUCKETS (64 * LATENCY_SUB)
+
+struct latency {
+	uint64_t count;
+	uint64_t max;
+	uint64_t bucket[LATENCY_BUCKETS];
+};
+
+/* Current time in ns, CLOCK_MONOTONIC */
+uint64_t latency_now();
+
+/* Adds value ns weight times */
+void latency_add(struct latency* h, uint64_t ns, uint64_t weight);
+
+void latency_merge(struct latency* dst, const struct latency* src);
+
+/* Value (lower bucket bound) below which the fraction q of values lies */
+uint64_t latency_percentile(const struct latency* h, double q);
@@ -0,0 +1,123 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Password Pad Benchmark 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * MD5 compression of MD5X_LANES independent blocks, the counterpart of
+ * sha1x.h. Data is stored word-major: word i of lane l is at
+ * [i * MD5X_LANES + l] in both state (4 words) and block (16 little endian
+ * words).
+ *
+ *	MD5X_NAME         function name
+ *	MD5X_LANES        lanes per vector
+ *	V                 vector of MD5X_LANES 32 bit words
+ *	LOAD(p), STORE(p, x), SET1(k)
+ *	ADD(x, y)
+ *	ROL(x, n)         rotate each word left by constant n
+ *	F1(b, c, d)       (b & c) | (~b & d)
+ *	F2(b, c, d)       b ^ c ^ d
+ *	FI(b, c, d)       c ^ (b | ~d)
+ */
+
+#define MD5X_F(b, c, d) F1(b, c, d)
+#define MD5X_G(b, c, d) F1(d, b, c)
+#define MD5X_H(b, c, d) F2(b, c, d)
+#define MD5X_I(b, c, d) FI(b, c, d)
+
+#define MD5X_STEP(F, a, b, c, d, k, s, T) \
+	a = ADD(b, ROL(ADD(ADD(a, F(b, c, d)), ADD(x[k], SET1(T))), s))
+
+void MD5X_NAME(uint32_t* state, const uint32_t* block)
+{
+	V x[16];
+	V a, b, c, d;
+	int i;
+
+	for(i = 0; i < 16; i++)
+		x[i] = LOAD(block + i * MD5X_LANES);
+
+	a = LOAD(state + 0 * MD5X_LANES);
+	b = LOAD(state + 1 * MD5X_LANES);
+	c = LOAD(state + 2 * MD5X_LANES);
+	d = LOAD(state + 3 * MD5X_LANES);
+
+	/* RFC 1321 3.4 */
+	MD5X_STEP(MD5X_F, a, b, c, d,  0,  7, 0xd76aa478);
+	MD5X_STEP(MD5X_F, d, a, b, c,  1, 12, 0xe8c7b756);
+	MD5X_STEP(MD5X_F, c, d, a, b,  2, 17, 0x242070db);
+	MD5X_STEP(MD5X_F, b, c, d, a,  3, 22, 0xc1bdceee);
+	MD5X_STEP(MD5X_F, a, b, c, d,  4,  7, 0xf57c0faf);
+	MD5X_STEP(MD5X_F, d, a, b, c,  5, 12, 0x4787c62a);
+	MD5X_STEP(MD5X_F, c, d, a, b,  6, 17, 0xa8304613);
+	MD5X_STEP(MD5X_F, b, c, d, a,  7, 22, 0xfd469501);
+	MD5X_STEP(MD5X_F, a, b, c, d,  8,  7, 0x698098d8);
+	MD5X_STEP(MD5X_F, d, a, b, c,  9, 12, 0x8b44f7af);
+	MD5X_STEP(MD5X_F, c, d, a, b, 10, 17, 0xffff5bb1);
+	MD5X_STEP(MD5X_F, b, c, d, a, 11, 22, 0x895cd7be);
+	MD5X_STEP(MD5X_F, a, b, c, d, 12,  7, 0x6b901122);
+	MD5X_STEP(MD5X_F, d, a, b, c, 13, 12, 0xfd987193);
+	MD5X_STEP(MD5X_F, c, d, a, b, 14, 17, 0xa679438e);
+	MD5X_STEP(MD5X_F, b, c, d, a, 15, 22, 0x49b40821);
+
+	MD5X_STEP(MD5X_G, a, b, c, d,  1,  5, 0xf61e2562);
+	MD5X_STEP(MD5X_G, d, a, b, c,  6,  9, 0xc040b340);
+	MD5X_STEP(MD5X_G, c, d, a, b, 11, 14, 0x265e5a51);
+	MD5X_STEP(MD5X_G, b, c, d, a,  0, 20, 0xe9b6c7aa);
+	MD5X_STEP(MD5X_G, a, b, c, d,  5,  5, 0xd62f105d);
+	MD5X_STEP(MD5X_G, d, a, b, c, 10,  9, 0x02441453);
+	MD5X_STEP(MD5X_G, c, d, a, b, 15, 14, 0xd8a1e681);
+	MD5X_STEP(MD5X_G, b, c, d, a,  4, 20, 0xe7d3fbc8);
+	MD5X_STEP(MD5X_G, a, b, c, d,  9,  5, 0x21e1cde6);
+	MD5X_STEP(MD5X_G, d, a, b, c, 14,  9, 0xc33707d6);
+	MD5X_STEP(MD5X_G, c, d, a, b,  3, 14, 0xf4d50d87);
+	MD5X_STEP(MD5X_G, b, c, d, a,  8, 20, 0x455a14ed);
+	MD5X_STEP(MD5X_G, a, b, c, d, 13,  5, 0xa9e3e905);
+	MD5X_STEP(MD5X_G, d, a, b, c,  2,  9, 0xfcefa3f8);
+	MD5X_STEP(MD5X_G, c, d, a, b,  7, 14, 0x676f02d9);
+	MD5X_STEP(MD5X_G, b, c, d, a, 12, 20, 0x8d2a4c8a);
+
+	MD5X_STEP(MD5X_H, a, b, c, d,  5,  4, 0xfffa3942);
+	MD5X_STEP(MD5X_H, d, a, b, c,  8, 11, 0x8771f681);
+	MD5X_STEP(MD5X_H, c, d, a, b, 11, 16, 0x6d9d6122);
+	MD5X_STEP(MD5X_H, b, c, d, a, 14, 23, 0xfde5380c);
+	MD5X_STEP(MD5X_H, a, b, c, d,  1,  4, 0xa4beea44);
+	MD5X_STEP(MD5X_H, d, a, b, c,  4, 11, 0x4bdecfa9);
+	MD5X_STEP(MD5X_H, c, d, a, b,  7, 16, 0xf6bb4b60);
+	MD5X_STEP(MD5X_H, b, c, d, a, 10, 23, 0xbebfbc70);
+	MD5X_STEP(MD5X_H, a, b, c, d, 13,  4, 0x289b7ec6);
+	MD5X_STEP(MD5X_H, d, a, b, c,  0, 11, 0xeaa127fa);
+	MD5X_STEP(MD5X_H, c, d, a, b,  3, 16, 0xd4ef3085);
+	MD5X_STEP(MD5X_H, b, c, d, a,  6, 23, 0x04881d05);
+	MD5X_STEP(MD5X_H, a, b, c, d,  9,  4, 0xd9d4d039);
+	MD5X_STEP(MD5X_H, d, a, b, c, 12, 11, 0xe6db99e5);
+	MD5X_STEP(MD5X_H, c, d, a, b, 15, 16, 0x1fa27cf8);
+	MD5X_STEP(MD5X_H, b, c, d, a,  2, 23, 0xc4ac5665);
+
+	MD5X_STEP(MD5X_I, a, b, c, d,  0,  6, 0xf4292244);
+	MD5X_STEP(MD5X_I, d, a, b, c,  7, 10, 0x432aff97);
+	MD5X_STEP(MD5X_I, c, d, a, b, 14, 15, 0xab9423a7);
+	MD5X_STEP(MD5X_I, b, c, d, a,  5, 21, 0xfc93a039);
+	MD5X_STEP(MD5X_I, a, b, c, d, 12,  6, 0x655b59c3);
+	MD5X_STEP(MD5X_I, d, a, b, c,  3, 10, 0x8f0ccc92);
+	MD5X_STEP(MD5X_I, c, d, a, b, 10, 15, 0xffeff47d);
+	MD5X_STEP(MD5X_I, b, c, d, a,  1, 21, 0x85845dd1);
+	MD5X_STEP(MD5X_I, a, b, c, d,  8,  6, 0x6fa87e4f);
+	MD5X_STEP(MD5X_I, d, a, b, c, 15, 10, 0xfe2ce6e0);
+	MD5X_STEP(MD5X_I, c, d, a, b,  6, 15, 0xa3014314);
+	MD5X_STEP(MD5X_I, b, c, d, a, 13, 21, 0x4e0811a1);
+	MD5X_STEP(MD5X_I, a, b, c, d,  4,  6, 0xf7537e82);
+	MD5X_STEP(MD5X_I, d, a, b, c, 11, 10, 0xbd3af235);
+	MD5X_STEP(MD5X_I, c, d, a, b,  2, 15, 0x2ad7d2bb);
+	MD5X_STEP(MD5X_I, b, c, d, a,  9, 21, 0xeb86d391);
+
+	STORE(state + 0 * MD5X_LANES, ADD(a, LOAD(state + 0 * MD5X_LANES)));
+	STORE(state + 1 * MD5X_LANES, ADD(b, LOAD(state + 1 * MD5X_LANES)));
+	STORE(state + 2 * MD5X_LANES, ADD(c, LOAD(state + 2 * MD5X_LANES)));
+	STORE(state + 3 * MD5X_LANES, ADD(d, LOAD(state + 3 * MD5X_LANES)));
+}
+
+#undef MD5X_STEP
+#undef MD5X_I
+#undef MD5X_H
+#undef MD5X_G
+#undef MD5X_F
@@ -0,0 +1,474 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Password Pad Benchmark 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Measures how fast the one time pads of all passwords 0-9A-Z of a given
+ * length can be derived on this machine, i.e. what an adversary having
+ * obtained keys.inc needs to try them all. Pads are derived as by
+ * set_decryption_key in ../trtotp.c: md5 of the 32 bytes password buffer
+ * (password followed by PASSWORDPADDINGBYTES), md5 of that, 20 bytes of
+ * both, KDF iterations of SHA-1 and the opad pad for midstates. Note that
+ * DEL on the calculator leaves the deleted character in the buffer, i.e.
+ * only passwords entered without corrections are derived correctly.
+ *
+ * All threads enumerate separate ranges of the passwords of one length,
+ * each in lanes of 4, 8 or 16 (md5x.h, sha1x.h). Lengths which can be
+ * exhausted within the measuring time are actually exhausted, for longer
+ * ones the time is extrapolated from the rate.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "hashx.h"
+
+#define MAXLANES          HASHX_MAXLANES
+#define DEFAULT_SECONDS   2.0
+#define CHECK_STOP        64  /* groups */
+
+/* as in ../trtotp.c, customized padding bytes need to be changed here, too */
+#define MAXPASSWORDLENGTH 14
+#define PASSWORDMEMSZ     32
+#define MAXKEYLENGTH      20
+#define SHA1_STATELENGTH  20
+
+static const unsigned char PASSWORDPADDINGBYTES[PASSWORDMEMSZ] = {
+	0xc5, 0xf7, 0x40, 0xd8, 0x1f, 0xda, 0x49, 0xb6,
+	0xe6, 0x1b, 0x5c, 0xee, 0xbd, 0x29, 0xbb, 0xa5,
+	0x89, 0x99, 0x93, 0x8f, 0x4b, 0x8b, 0xca, 0x40,
+	0xbb, 0x5a, 0xb4, 0x05, 0x1b, 0x9a, 0xe7, 0x4d
+};
+
+/* screen_1_get_password */
+static const char CHARSET[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+#define NUM_CHARS 36
+
+static const uint32_t MD5_IV[4] = {
+	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476
+};
+
+static const uint32_t SHA1_IV[5] = {
+	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+/* -- Pad Derivation -- */
+
+struct derive {
+	const struct hashx_impl* im;
+	unsigned iterations;
+	int midstates;
+	uint32_t pw[16 * MAXLANES];      /* block of the password buffer */
+	uint32_t h1[4 * MAXLANES];
+	uint32_t h1block[16 * MAXLANES];
+	uint32_t h2[4 * MAXLANES];
+	uint32_t sblock[16 * MAXLANES];
+	uint32_t sstate[5 * MAXLANES];
+	uint32_t pad[10 * MAXLANES];     /* big endian words */
+};
+
+static uint32_t le32(const unsigned char* p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+							(uint32_t)p[3] << 24;
+}
+
+/* Constant parts of the blocks, words 0-3 of pw are set per password */
+static void derive_init(struct derive* d, const struct hashx_impl* im,
+					unsigned iterations, int midstates)
+{
+	const unsigned lanes = im->lanes;
+	unsigned l;
+	unsigned w;
+
+	memset(d, 0, sizeof(struct derive));
+	d->im = im;
+	d->iterations = iterations;
+	d->midstates = midstates;
+	for(l = 0; l < lanes; l++) {
+		/* bytes 16-31 are always padding bytes */
+		for(w = 4; w < 8; w++)
+			d->pw[w * lanes + l] = le32(PASSWORDPADDINGBYTES + 4 * w);
+		d->pw[8 * lanes + l] = 0x80;
+		d->pw[14 * lanes + l] = PASSWORDMEMSZ * 8;
+		d->h1block[4 * lanes + l] = 0x80;
+		d->h1block[14 * lanes + l] = 16 * 8;
+		d->sblock[5 * lanes + l] = 0x80000000;
+		d->sblock[15 * lanes + l] = SHA1_STATELENGTH * 8;
+	}
+}
+
+/* SHA-1 of the 20 bytes in sblock words 0-4 replacing them, as sha_iterate */
+static void derive_sha1(struct derive* d)
+{
+	const unsigned lanes = d->im->lanes;
+	unsigned i;
+
+	for(i = 0; i < 5 * lanes; i++)
+		d->sstate[i] = SHA1_IV[i / lanes];
+	d->im->sha1x(d->sstate, d->sblock);
+	memcpy(d->sblock, d->sstate, 5 * lanes * sizeof(uint32_t));
+}
+
+/* Pads of the passwords in pw words 0-3 */
+static void derive_pads(struct derive* d)
+{
+	const unsigned lanes = d->im->lanes;
+	unsigned i;
+
+	/* callcalc_md5_compute of the password buffer and its digest */
+	for(i = 0; i < 4 * lanes; i++)
+		d->h1[i] = d->h2[i] = MD5_IV[i / lanes];
+	d->im->md5x(d->h1, d->pw);
+	memcpy(d->h1block, d->h1, 4 * lanes * sizeof(uint32_t));
+	d->im->md5x(d->h2, d->h1block);
+
+	/* MAXKEYLENGTH bytes: all of h1, the first word of h2 */
+	for(i = 0; i < 4 * lanes; i++)
+		d->sblock[i] = __builtin_bswap32(d->h1[i]);
+	for(i = 0; i < lanes; i++)
+		d->sblock[4 * lanes + i] = __builtin_bswap32(d->h2[i]);
+
+	for(i = 0; i < d->iterations; i++)
+		derive_sha1(d);
+	memcpy(d->pad, d->sblock, 5 * lanes * sizeof(uint32_t));
+	if(d->midstates) {
+		derive_sha1(d);
+		memcpy(d->pad + 5 * lanes, d->sblock,
+					5 * lanes * sizeof(uint32_t));
+	}
+}
+
+/* Password bytes 0-15 (rest padding) into lane l */
+static void derive_set(struct derive* d, unsigned l, const unsigned char* pw)
+{
+	unsigned w;
+
+	for(w = 0; w < 4; w++)
+		d->pw[w * d->im->lanes + l] = le32(pw + 4 * w);
+}
+
+/* -- Enumeration -- */
+
+struct worker {
+	pthread_t thread;
+	const struct hashx_impl* im;
+	unsigned len;
+	uint64_t start;
+	uint64_t count;   /* 0: until stop */
+	uint64_t done;
+	uint32_t sink;    /* keeps the pads alive */
+};
+
+static unsigned iterations = 0;
+static int midstates = 0;
+static int stop = 0;
+
+static void* worker_main(void* arg)
+{
+	struct worker* wk = arg;
+	struct derive d;
+	unsigned char pw[16];
+	unsigned digit[MAXPASSWORDLENGTH];
+	const unsigned lanes = wk->im->lanes;
+	uint64_t x = wk->start;
+	uint64_t groups = 0;
+	unsigned i;
+	unsigned l;
+
+	derive_init(&d, wk->im, iterations, midstates);
+	memcpy(pw, PASSWORDPADDINGBYTES, sizeof(pw));
+	for(i = 0; i < wk->len; i++) {
+		digit[i] = x % NUM_CHARS;
+		pw[i] = CHARSET[digit[i]];
+		x /= NUM_CHARS;
+	}
+
+	wk->done = 0;
+	while(wk->count == 0 || wk->done < wk->count) {
+		/* odometer, first character fastest */
+		for(l = 0; l < lanes; l++) {
+			derive_set(&d, l, pw);
+			for(i = 0; i < wk->len; i++) {
+				if(++digit[i] < NUM_CHARS) {
+					pw[i] = CHARSET[digit[i]];
+					break;
+				}
+				digit[i] = 0;
+				pw[i] = CHARSET[0];
+			}
+		}
+		derive_pads(&d);
+		for(l = 0; l < lanes; l++)
+			wk->sink ^= d.pad[l];
+		wk->done += lanes;
+
+		if(++groups % CHECK_STOP == 0 &&
+				__atomic_load_n(&stop, __ATOMIC_RELAXED))
+			break;
+	}
+	/* the last group may exceed the range */
+	if(wk->count != 0 && wk->done > wk->count)
+		wk->done = wk->count;
+	return NULL;
+}
+
+static double now_s()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Runs all threads on passwords of length len: with count 0 for the given
+ * time, otherwise exhausts the count passwords from 0. Returns the rate.
+ */
+static double run(struct worker* wk, unsigned num_threads, unsigned len,
+				uint64_t count, double seconds, double* took)
+{
+	struct timespec ts;
+	uint64_t done = 0;
+	double t0;
+	unsigned i;
+
+	__atomic_store_n(&stop, 0, __ATOMIC_RELAXED);
+	t0 = now_s();
+	for(i = 0; i < num_threads; i++) {
+		wk[i].len = len;
+		wk[i].start = (count == 0) ? 0 : (count / num_threads * i);
+		wk[i].count = (count == 0) ? 0 : (i == num_threads - 1) ?
+				(count - wk[i].start) : (count / num_threads);
+		if(count != 0 && wk[i].count == 0)
+			wk[i].count = 1;  /* fewer passwords than threads */
+		if(pthread_create(&wk[i].thread, NULL, worker_main, wk + i)
+									!= 0) {
+			fprintf(stderr, "ERROR: Failed to start thread\n");
+			exit(2);
+		}
+	}
+	if(count == 0) {
+		ts.tv_sec = (time_t)seconds;
+		ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+		nanosleep(&ts, NULL);
+		__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+	}
+	for(i = 0; i < num_threads; i++) {
+		pthread_join(wk[i].thread, NULL);
+		done += wk[i].done;
+	}
+	*took = now_s() - t0;
+	return done / *took;
+}
+
+/* -- Output -- */
+
+static void format_duration(char* buf, size_t bufsz, double s)
+{
+	if(s < 60)
+		snprintf(buf, bufsz, "%.3f s", s);
+	else if(s < 3600)
+		snprintf(buf, bufsz, "%.1f min", s / 60);
+	else if(s < 86400)
+		snprintf(buf, bufsz, "%.1f h", s / 3600);
+	else if(s < 86400 * 365.25)
+		snprintf(buf, bufsz, "%.1f d", s / 86400);
+	else
+		snprintf(buf, bufsz, "%.3g years", s / (86400 * 365.25));
+}
+
+static void print_pad(const struct hashx_impl* im, const char* password)
+{
+	struct derive d;
+	unsigned char pw[16];
+	unsigned words = midstates ? 10 : 5;
+	unsigned i;
+
+	derive_init(&d, im, iterations, midstates);
+	memcpy(pw, PASSWORDPADDINGBYTES, sizeof(pw));
+	memcpy(pw, password, strlen(password));
+	for(i = 0; i < im->lanes; i++)
+		derive_set(&d, i, pw);
+	derive_pads(&d);
+	for(i = 0; i < words; i++)
+		printf("%08x", d.pad[i * im->lanes]);
+	printf("\n");
+}
+
+/* RFC 1321 and FIPS 180 "abc" and all lanes against the scalar code */
+static int self_test(const struct hashx_impl* im)
+{
+	static const unsigned char PW[16] = "Z09ABCDEFGHIJKLM";
+	const struct hashx_impl* scalar = hashx_find("scalar");
+	struct derive ref;
+	struct derive d;
+	uint32_t md5[4];
+	uint32_t sha[5];
+	uint32_t block[16];
+	unsigned char pw[16];
+	unsigned l;
+	unsigned i;
+
+	memset(block, 0, sizeof(block));
+	block[0] = 0x80636261;
+	block[14] = 24;
+	memcpy(md5, MD5_IV, sizeof(md5));
+	scalar->md5x(md5, block);
+	if(md5[0] != 0x98500190 || md5[3] != 0x727fe128)
+		return 0;
+
+	memset(block, 0, sizeof(block));
+	block[0] = 0x61626380;
+	block[15] = 24;
+	memcpy(sha, SHA1_IV, sizeof(sha));
+	scalar->sha1x(sha, block);
+	if(sha[0] != 0xa9993e36 || sha[4] != 0x9cd0d89d)
+		return 0;
+
+	/* different password lengths in the lanes */
+	derive_init(&d, im, iterations, 1);
+	for(l = 0; l < im->lanes; l++) {
+		memcpy(pw, PASSWORDPADDINGBYTES, sizeof(pw));
+		memcpy(pw, PW, 1 + l % MAXPASSWORDLENGTH);
+		derive_set(&d, l, pw);
+	}
+	derive_pads(&d);
+	derive_init(&ref, scalar, iterations, 1);
+	for(l = 0; l < im->lanes; l++) {
+		memcpy(pw, PASSWORDPADDINGBYTES, sizeof(pw));
+		memcpy(pw, PW, 1 + l % MAXPASSWORDLENGTH);
+		derive_set(&ref, 0, pw);
+		derive_pads(&ref);
+		for(i = 0; i < 10; i++)
+			if(ref.pad[i] != d.pad[i * im->lanes + l])
+				return 0;
+	}
+	return 1;
+}
+
+static void usage(const char* name)
+{
+	printf(
+"USAGE %s [-j THREADS] [-s SECONDS] [-l LENGTH] [-n ITERATIONS] [-m]\n"
+"                 [-i IMPL] [-p PASSWORD]\n"
+"\n"
+" -j  number of threads, default: number of CPUs\n"
+" -s  time to measure the rate, lengths taking less are exhausted\n"
+" -l  longest password length, default %d\n"
+" -n  KDF iterations as in section global of secretkeys.ini, default 0\n"
+" -m  also derive the pad for the opad states (midstates=1)\n"
+" -i  hashing implementation (scalar, sse2, avx2 or avx512)\n"
+" -p  only print the pad for PASSWORD (hex) and exit\n",
+						name, MAXPASSWORDLENGTH);
+}
+
+int main(int argc, char** argv)
+{
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	double seconds = DEFAULT_SECONDS;
+	unsigned maxlen = MAXPASSWORDLENGTH;
+	const struct hashx_impl* im;
+	const char* impl = NULL;
+	const char* password = NULL;
+	struct worker* wk;
+	char buf[32];
+	char buf2[32];
+	double rate;
+	double took;
+	double space;
+	double total = 0;
+	double t;
+	int measured;
+	uint32_t sink = 0;
+	unsigned len;
+	unsigned i;
+	int opt;
+
+	while((opt = getopt(argc, argv, "j:s:l:n:mi:p:h")) != -1) {
+		switch(opt) {
+		case 'j': num_threads = strtol(optarg, NULL, 10);  break;
+		case 's': seconds = strtod(optarg, NULL);          break;
+		case 'l': maxlen = strtoul(optarg, NULL, 10);      break;
+		case 'n': iterations = strtoul(optarg, NULL, 10);  break;
+		case 'm': midstates = 1;                           break;
+		case 'p': password = optarg;                       break;
+		case 'i': impl = optarg;                           break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(optind != argc || num_threads < 1 || seconds <= 0 || maxlen < 1 ||
+					maxlen > MAXPASSWORDLENGTH || (password
+					!= NULL && (strlen(password) >
+					MAXPASSWORDLENGTH ||
+					strspn(password, CHARSET) !=
+					strlen(password)))) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if(impl == NULL) {
+		im = hashx_best();
+	} else if((im = hashx_find(impl)) == NULL) {
+		fprintf(stderr, "ERROR: Implementation %s not supported\n",
+									impl);
+		return 1;
+	}
+
+	if(!self_test(im)) {
+		fprintf(stderr, "ERROR: Self test of %s failed\n", im->name);
+		return 1;
+	}
+	if(password != NULL) {
+		print_pad(im, password);
+		return 0;
+	}
+
+	if((wk = calloc(num_threads, sizeof(struct worker))) == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return 2;
+	}
+	for(i = 0; i < num_threads; i++)
+		wk[i].im = im;
+
+	rate = run(wk, num_threads, maxlen, 0, seconds, &took);
+	for(i = 0; i < num_threads; i++)
+		sink ^= wk[i].sink;
+	printf("%s, %u lanes, %ld threads, %u KDF iterations%s\n", im->name,
+			im->lanes, num_threads, iterations,
+			midstates ? ", midstates" : "");
+	printf("%.0f passwords/s\n\n", rate);
+	printf("%6s %12s %16s %16s\n", "length", "passwords", "exhaust",
+								"up to length");
+
+	for(len = 1, space = NUM_CHARS; len <= maxlen; len++,
+							space *= NUM_CHARS) {
+		measured = (space / rate < seconds);
+		if(measured) {
+			run(wk, num_threads, len, (uint64_t)space, seconds, &t);
+			for(i = 0; i < num_threads; i++)
+				sink ^= wk[i].sink;
+		} else {
+			t = space / rate;
+		}
+		total += t;
+		format_duration(buf, sizeof(buf), t);
+		format_duration(buf2, sizeof(buf2), total);
+		printf("%6u %12.4g %16s %16s%s\n", len, space, buf, buf2,
+					measured ? " (measured)" : "");
+	}
+	printf("\n(checksum %08x)\n", sink);
+	free(wk);
+	return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Thread Pool 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Submitters push and count a task while holding the pool lock, hence a
+ * worker never takes a task before it is counted in pending. Workers only
+ * ever hold one lock at a time.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+
+#define INITIAL_CAP 64
+
+static int deque_push(struct pool_worker* w, struct pool_task* task)
+{
+	struct pool_task** nv;
+	size_t i;
+
+	pthread_mutex_lock(&w->lock);
+	if(w->tail - w->head == w->cap) {
+		if((nv = malloc(2 * w->cap * sizeof(struct pool_task*)))
+								== NULL) {
+			pthread_mutex_unlock(&w->lock);
+			return -1;
+		}
+		for(i = w->head; i != w->tail; i++)
+			nv[i & (2 * w->cap - 1)] = w->v[i & (w->cap - 1)];
+		free(w->v);
+		w->v = nv;
+		w->cap *= 2;
+	}
+	w->v[w->tail++ & (w->cap - 1)] = task;
+	pthread_mutex_unlock(&w->lock);
+	return 0;
+}
+
+/* own work: newest first, i.e. the one most likely still in cache */
+static struct pool_task* deque_take(struct pool_worker* w)
+{
+	struct pool_task* task = NULL;
+
+	pthread_mutex_lock(&w->lock);
+	if(w->tail != w->head)
+		task = w->v[--w->tail & (w->cap - 1)];
+	pthread_mutex_unlock(&w->lock);
+	return task;
+}
+
+/* others' work: oldest first */
+static struct pool_task* deque_steal(struct pool_worker* w)
+{
+	struct pool_task* task = NULL;
+
+	pthread_mutex_lock(&w->lock);
+	if(w->tail != w->head)
+		task = w->v[w->head++ & (w->cap - 1)];
+	pthread_mutex_unlock(&w->lock);
+	return task;
+}
+
+static void* worker_main(void* arg)
+{
+	struct pool_worker* w = arg;
+	struct pool* p = w->pool;
+	struct pool_task* task;
+	unsigned i;
+
+	for(;;) {
+		task = deque_take(w);
+		for(i = 1; task == NULL && i < p->num_workers; i++)
+			task = deque_steal(&p->w[(w->idx + i) % p->num_workers]);
+
+		pthread_mutex_lock(&p->lock);
+		if(task != NULL) {
+			p->pending--;
+			pthread_mutex_unlock(&p->lock);
+			task->run(task, w->idx);
+			continue;
+		}
+		while(p->pending == 0 && !p->stop)
+			pthread_cond_wait(&p->work, &p->lock);
+		if(p->stop) {
+			pthread_mutex_unlock(&p->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&p->lock);
+	}
+}
+
+int pool_start(struct pool* p, unsigned num_workers)
+{
+	unsigned i;
+
+	memset(p, 0, sizeof(struct pool));
+	if((p->w = calloc(num_workers, sizeof(struct pool_worker))) == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return -1;
+	}
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->work, NULL);
+
+	for(i = 0; i < num_workers; i++) {
+		p->w[i].pool = p;
+		p->w[i].idx = i;
+		p->w[i].cap = INITIAL_CAP;
+		pthread_mutex_init(&p->w[i].lock, NULL);
+		if((p->w[i].v = malloc(INITIAL_CAP * sizeof(struct pool_task*)))
+								== NULL) {
+			fprintf(stderr, "ERROR: Out of memory\n");
+			pool_stop(p);
+			return -1;
+		}
+		if(pthread_create(&p->w[i].thread, NULL, worker_main, p->w + i)
+									!= 0) {
+			fprintf(stderr, "ERROR: Failed to start worker %u\n", i);
+			free(p->w[i].v);
+			pool_stop(p);
+			return -1;
+		}
+		p->num_workers = i + 1;
+	}
+	return 0;
+}
+
+int pool_submit(struct pool* p, struct pool_task* task)
+{
+	int rv;
+
+	pthread_mutex_lock(&p->lock);
+	rv = deque_push(&p->w[p->next], task);
+	p->next = (p->next + 1) % p->num_workers;
+	if(rv == 0) {
+		p->pending++;
+		pthread_cond_signal(&p->work);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return rv;
+}
+
+void pool_stop(struct pool* p)
+{
+	unsigned i;
+
+	pthread_mutex_lock(&p->lock);
+	p->stop = 1;
+	pthread_cond_broadcast(&p->work);
+	pthread_mutex_unlock(&p->lock);
+
+	for(i = 0; i < p->num_workers; i++) {
+		pthread_join(p->w[i].thread, NULL);
+		free(p->w[i].v);
+		pthread_mutex_destroy(&p->w[i].lock);
+	}
+	free(p->w);
+	pthread_mutex_destroy(&p->lock);
+	pthread_cond_destroy(&p->work);
+	memset(p, 0, sizeof(struct pool));
+}
@@ -0,0 +1,47 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Thread Pool 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Work stealing thread pool: each worker has a deque of tasks. Submitted
+ * tasks are distributed round robin, a worker runs its own tasks newest
+ * first and when out of work, steals the oldest task of another worker.
+ * Deques are protected by a mutex each, they only grow.
+ */
+
+#include <stddef.h>
+#include <pthread.h>
+
+struct pool_task {
+	void (*run)(struct pool_task* task, unsigned worker);
+};
+
+struct pool_worker {
+	struct pool* pool;
+	unsigned idx;
+	pthread_t thread;
+	pthread_mutex_t lock;  /* deque */
+	struct pool_task** v;
+	size_t cap;            /* power of two */
+	size_t head;           /* oldest, stolen by others */
+	size_t tail;           /* one after the newest, taken by the owner */
+};
+
+struct pool {
+	unsigned num_workers;
+	struct pool_worker* w;
+	pthread_mutex_t lock;  /* pending, next and stop */
+	pthread_cond_t work;
+	size_t pending;        /* submitted, not yet taken */
+	unsigned next;
+	int stop;
+};
+
+/* Returns 0 on success, prints an error and returns -1 otherwise */
+int pool_start(struct pool* p, unsigned num_workers);
+
+/* Task must stay valid until its run function was called, 0 on success */
+int pool_submit(struct pool* p, struct pool_task* task);
+
+/* Waits for all workers to exit, tasks not yet run are dropped */
+void pool_stop(struct pool* p);
@@ -0,0 +1,80 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Batch HOTP 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * SHA-1 compression of SHA1X_LANES independent blocks, instantiated once
+ * per instruction set by defining the vector type V and operations below
+ * before including this file. Data is stored word-major: word i of lane l
+ * is at [i * SHA1X_LANES + l] in both state (5 words) and block (16 words).
+ *
+ *	SHA1X_NAME        function name
+ *	SHA1X_LANES       lanes per vector
+ *	V                 vector of SHA1X_LANES 32 bit words
+ *	LOAD(p), STORE(p, x), SET1(k)
+ *	ADD(x, y), XOR(x, y)
+ *	ROL(x, n)         rotate each word left by constant n
+ *	F1(b, c, d)       (b & c) | (~b & d)
+ *	F2(b, c, d)       b ^ c ^ d
+ *	F3(b, c, d)       (b & c) | (b & d) | (c & d)
+ */
+
+#define SHA1X_ROUND(F, K, i) \
+	do { \
+		if(i >= 16) \
+			w[(i) & 15] = ROL(XOR(XOR(w[((i) + 13) & 15], \
+					w[((i) + 8) & 15]), XOR(w[((i) + 2) & 15], \
+					w[(i) & 15])), 1); \
+		t = ADD(ADD(ROL(a, 5), F(b, c, d)), \
+				ADD(ADD(e, SET1(K)), w[(i) & 15])); \
+		e = d; \
+		d = c; \
+		c = ROL(b, 30); \
+		b = a; \
+		a = t; \
+	} while(0)
+
+/* rounds fully unrolled such that w[] indices are constants (registers) */
+#define SHA1X_ROUND4(F, K, i) \
+	SHA1X_ROUND(F, K, i); \
+	SHA1X_ROUND(F, K, (i) + 1); \
+	SHA1X_ROUND(F, K, (i) + 2); \
+	SHA1X_ROUND(F, K, (i) + 3)
+
+#define SHA1X_ROUND20(F, K, i) \
+	SHA1X_ROUND4(F, K, i); \
+	SHA1X_ROUND4(F, K, (i) + 4); \
+	SHA1X_ROUND4(F, K, (i) + 8); \
+	SHA1X_ROUND4(F, K, (i) + 12); \
+	SHA1X_ROUND4(F, K, (i) + 16)
+
+void SHA1X_NAME(uint32_t* state, const uint32_t* block)
+{
+	V w[16];
+	V a, b, c, d, e, t;
+	int i;
+
+	for(i = 0; i < 16; i++)
+		w[i] = LOAD(block + i * SHA1X_LANES);
+
+	a = LOAD(state + 0 * SHA1X_LANES);
+	b = LOAD(state + 1 * SHA1X_LANES);
+	c = LOAD(state + 2 * SHA1X_LANES);
+	d = LOAD(state + 3 * SHA1X_LANES);
+	e = LOAD(state + 4 * SHA1X_LANES);
+
+	SHA1X_ROUND20(F1, 0x5a827999, 0);
+	SHA1X_ROUND20(F2, 0x6ed9eba1, 20);
+	SHA1X_ROUND20(F3, 0x8f1bbcdc, 40);
+	SHA1X_ROUND20(F2, 0xca62c1d6, 60);
+
+	STORE(state + 0 * SHA1X_LANES, ADD(a, LOAD(state + 0 * SHA1X_LANES)));
+	STORE(state + 1 * SHA1X_LANES, ADD(b, LOAD(state + 1 * SHA1X_LANES)));
+	STORE(state + 2 * SHA1X_LANES, ADD(c, LOAD(state + 2 * SHA1X_LANES)));
+	STORE(state + 3 * SHA1X_LANES, ADD(d, LOAD(state + 3 * SHA1X_LANES)));
+	STORE(state + 4 * SHA1X_LANES, ADD(e, LOAD(state + 4 * SHA1X_LANES)));
+}
+
+#undef SHA1X_ROUND20
+#undef SHA1X_ROUND4
+#undef SHA1X_ROUND
@@ -0,0 +1,30 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Batch HOTP 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * 8 lanes, compiled with -mavx2. Only called if the CPU supports AVX2.
+ */
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#define SHA1X_NAME  sha1x_avx2
+#define SHA1X_LANES 8
+
+#define V           __m256i
+#define LOAD(p)     _mm256_loadu_si256((const __m256i*)(p))
+#define STORE(p, x) _mm256_storeu_si256((__m256i*)(p), x)
+#define SET1(k)     _mm256_set1_epi32((int)(k))
+#define ADD(x, y)   _mm256_add_epi32(x, y)
+#define XOR(x, y)   _mm256_xor_si256(x, y)
+#define ROL(x, n)   _mm256_or_si256(_mm256_slli_epi32(x, n), \
+						_mm256_srli_epi32(x, 32 - (n)))
+#define F1(b, c, d) XOR(d, _mm256_and_si256(b, XOR(c, d)))
+#define F2(b, c, d) XOR(XOR(b, c), d)
+#define F3(b, c, d) _mm256_or_si256(_mm256_and_si256(b, c), \
+				_mm256_and_si256(d, _mm256_or_si256(b, c)))
+
+void sha1x_avx2(uint32_t* state, const uint32_t* block);
+
+#include "sha1x.h"
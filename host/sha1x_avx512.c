@@ -0,0 +1,30 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Batch HOTP 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * 16 lanes, compiled with -mavx512f. Only called if the CPU supports
+ * AVX-512F. Uses the native rotate and ternary logic for the round
+ * functions (truth tables 0xca: choose, 0x96: parity, 0xe8: majority).
+ */
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#define SHA1X_NAME  sha1x_avx512
+#define SHA1X_LANES 16
+
+#define V           __m512i
+#define LOAD(p)     _mm512_loadu_si512((const void*)(p))
+#define STORE(p, x) _mm512_storeu_si512((void*)(p), x)
+#define SET1(k)     _mm512_set1_epi32((int)(k))
+#define ADD(x, y)   _mm512_add_epi32(x, y)
+#define XOR(x, y)   _mm512_xor_si512(x, y)
+#define ROL(x, n)   _mm512_rol_epi32(x, n)
+#define F1(b, c, d) _mm512_ternarylogic_epi32(b, c, d, 0xca)
+#define F2(b, c, d) _mm512_ternarylogic_epi32(b, c, d, 0x96)
+#define F3(b, c, d) _mm512_ternarylogic_epi32(b, c, d, 0xe8)
+
+void sha1x_avx512(uint32_t* state, const uint32_t* block);
+
+#include "sha1x.h"
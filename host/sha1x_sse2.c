@@ -0,0 +1,30 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Batch HOTP 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * 4 lanes, compiled with -msse2 (baseline on x86-64).
+ */
+
+#include <stdint.h>
+#include <emmintrin.h>
+
+#define SHA1X_NAME  sha1x_sse2
+#define SHA1X_LANES 4
+
+#define V           __m128i
+#define LOAD(p)     _mm_loadu_si128((const __m128i*)(p))
+#define STORE(p, x) _mm_storeu_si128((__m128i*)(p), x)
+#define SET1(k)     _mm_set1_epi32((int)(k))
+#define ADD(x, y)   _mm_add_epi32(x, y)
+#define XOR(x, y)   _mm_xor_si128(x, y)
+#define ROL(x, n)   _mm_or_si128(_mm_slli_epi32(x, n), \
+						_mm_srli_epi32(x, 32 - (n)))
+#define F1(b, c, d) XOR(d, _mm_and_si128(b, XOR(c, d)))
+#define F2(b, c, d) XOR(XOR(b, c), d)
+#define F3(b, c, d) _mm_or_si128(_mm_and_si128(b, c), \
+					_mm_and_si128(d, _mm_or_si128(b, c)))
+
+void sha1x_sse2(uint32_t* state, const uint32_t* block);
+
+#include "sha1x.h"
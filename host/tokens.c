@@ -0,0 +1,478 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Token Table 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hotp_batch.h"
+#include "hashx.h"
+#include "tokens.h"
+
+#define LINELENGTH 512
+
+/* as secret_keys_to_inc.pl */
+#define DEFAULT_DIGITS   6
+#define DEFAULT_TIMESTEP 30
+
+/* TOKEN_KEY casts, records and the key field are 4 byte aligned */
+typedef char token_key_fits[(sizeof(struct hotp_key) <= TOKEN_KEYFIELD &&
+			offsetof(struct token, key) % 4 == 0 &&
+			sizeof(struct token) % 4 == 0) ? 1 : -1];
+
+/* -- secretkeys.ini -- */
+
+static char* trim(char* s)
+{
+	char* end;
+
+	while(isspace((unsigned char)*s))
+		s++;
+	end = s + strlen(s);
+	while(end > s && isspace((unsigned char)end[-1]))
+		*--end = 0;
+	return s;
+}
+
+/* RFC 4648 Base32, case insensitive, padding and blanks ignored */
+static int base32_decode(const char* in, unsigned char* out, size_t outsz)
+{
+	uint32_t acc = 0;
+	unsigned bits = 0;
+	size_t len = 0;
+	int v;
+
+	for(; *in; in++) {
+		if(*in == '=' || isspace((unsigned char)*in))
+			continue;
+		if(isalpha((unsigned char)*in))
+			v = toupper((unsigned char)*in) - 'A';
+		else if(*in >= '2' && *in <= '7')
+			v = *in - '2' + 26;
+		else
+			return -1;
+
+		acc = (acc << 5) | v;
+		bits += 5;
+		if(bits >= 8) {
+			bits -= 8;
+			if(len == outsz)
+				return -1;
+			out[len++] = (acc >> bits) & 0xff;
+		}
+	}
+	return (int)len;
+}
+
+/*
+ * RFC 2104: Seeds longer than the SHA-1 block are replaced by their digest,
+ * as in secret_keys_to_inc.pl. One seed per token, hence the scalar lane.
+ */
+static void seed_digest(unsigned char* out, const unsigned char* seed,
+								size_t len)
+{
+	const struct hashx_impl* im = hashx_find("scalar");
+	uint32_t state[5] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+	};
+	uint32_t block[16];
+	unsigned char pad[64];
+	uint64_t bits = (uint64_t)len * 8;
+	size_t padded = ((len + 8) / 64 + 1) * 64;  /* 0x80 and bit count */
+	size_t off;
+	size_t pos;
+	unsigned k;
+
+	for(off = 0; off < padded; off += 64) {
+		for(k = 0; k < 64; k++) {
+			pos = off + k;
+			if(pos < len)
+				pad[k] = seed[pos];
+			else if(pos == len)
+				pad[k] = 0x80;
+			else if(pos >= padded - 8)
+				pad[k] = (bits >> (8 * (padded - 1 - pos))) & 0xff;
+			else
+				pad[k] = 0;
+		}
+		for(k = 0; k < 16; k++)
+			block[k] = (uint32_t)pad[4 * k] << 24 |
+					(uint32_t)pad[4 * k + 1] << 16 |
+					(uint32_t)pad[4 * k + 2] << 8 |
+					(uint32_t)pad[4 * k + 3];
+		im->sha1x(state, block);
+	}
+	for(k = 0; k < 20; k++)
+		out[k] = (state[k / 4] >> (24 - 8 * (k % 4))) & 0xff;
+}
+
+/* Seeds above 20 bytes do not fit the key field, their states do */
+static void token_set_key(struct token* tok, const unsigned char* seed,
+								size_t len)
+{
+	struct hotp_key hk;
+	unsigned char digest[20];
+	unsigned char keylen;
+
+	if(len > 64) {
+		seed_digest(digest, seed, len);
+		seed = digest;
+		len = sizeof(digest);
+	}
+	if(len <= TOKEN_MAXSEED) {
+		memcpy(tok->key, seed, len);
+		tok->keylen = len;
+		return;
+	}
+	keylen = len;
+	hotp_batch_key(&hk, &seed, &keylen, 1);
+	memcpy(tok->key, &hk, sizeof(struct hotp_key));
+	tok->type |= TOKEN_MIDSTATE;
+	tok->keylen = 0;
+}
+
+static struct token* token_add(struct tokens* t, size_t* cap,
+							const char* name)
+{
+	struct token* tok;
+
+	if(t->len == *cap) {
+		*cap = (*cap == 0) ? 64 : (*cap * 2);
+		tok = realloc(t->own, *cap * sizeof(struct token));
+		if(tok == NULL)
+			return NULL;
+		t->own = tok;
+		t->tok = tok;
+	}
+	tok = t->own + t->len++;
+	memset(tok, 0, sizeof(struct token));
+	strcpy(tok->name, name);
+	tok->digits = DEFAULT_DIGITS;
+	tok->timestep = DEFAULT_TIMESTEP;
+	tok->type = TOKEN_TOTP;
+	return tok;
+}
+
+static int token_check(const char* file, const struct token* tok)
+{
+	if(memchr(tok->name, 0, TOKEN_NAMELENGTH) == NULL) {
+		fprintf(stderr, "ERROR: %s: Unterminated token name\n", file);
+		return -1;
+	}
+	if(!(tok->type & TOKEN_MIDSTATE) && (tok->keylen == 0 ||
+					tok->keylen > TOKEN_MAXSEED)) {
+		fprintf(stderr, "ERROR: %s: [%s] has no key\n", file, tok->name);
+		return -1;
+	}
+	if(tok->digits < 6 || tok->digits > 8 ||
+			(tok->timestep == 0 && !(tok->type & TOKEN_HOTP))) {
+		fprintf(stderr, "ERROR: %s: [%s] digits must be 6-8 and "
+				"timestep 1-255\n", file, tok->name);
+		return -1;
+	}
+	return 0;
+}
+
+static int tokens_load_ini(struct tokens* t, const char* file, FILE* fd)
+{
+	char line[LINELENGTH];
+	unsigned char seed[TOKEN_MAXINI];
+	struct token* cur = NULL;
+	size_t cap = 0;
+	size_t lineno = 0;
+	char* s;
+	char* val;
+	int len;
+
+	while(fgets(line, sizeof(line), fd) != NULL) {
+		lineno++;
+		s = trim(line);
+		if(*s == 0 || *s == ';' || *s == '#')
+			continue;
+
+		if(*s == '[') {
+			if(cur != NULL && token_check(file, cur) != 0)
+				goto fail;
+			if((val = strchr(s, ']')) == NULL)
+				goto syntax;
+			*val = 0;
+			s = trim(s + 1);
+			if(strcmp(s, "global") == 0) {
+				cur = NULL;
+				continue;
+			}
+			if(strlen(s) >= TOKEN_NAMELENGTH) {
+				fprintf(stderr, "ERROR: %s:%lu: Names are limited "
+						"to %d characters\n", file,
+						(unsigned long)lineno,
+						TOKEN_NAMELENGTH - 1);
+				goto fail;
+			}
+			if((cur = token_add(t, &cap, s)) == NULL) {
+				fprintf(stderr, "ERROR: Out of memory\n");
+				goto fail;
+			}
+			continue;
+		}
+
+		if((val = strchr(s, '=')) == NULL)
+			goto syntax;
+		*val++ = 0;
+		s = trim(s);
+		val = trim(val);
+		if(cur == NULL)
+			continue;  /* [global] or before the first section */
+
+		if(strcmp(s, "key") == 0) {
+			if((len = base32_decode(val, seed, TOKEN_MAXINI)) <= 0) {
+				fprintf(stderr, "ERROR: %s:%lu: key must be "
+					"Base32 of at most %d bytes\n", file,
+					(unsigned long)lineno, TOKEN_MAXINI);
+				goto fail;
+			}
+			token_set_key(cur, seed, len);
+		} else if(strcmp(s, "digits") == 0) {
+			cur->digits = atoi(val);
+		} else if(strcmp(s, "timestep") == 0) {
+			len = atoi(val);
+			cur->timestep = (len > 255) ? 0 : len;
+		} else if(strcmp(s, "type") == 0) {
+			/* any case, like secret_keys_to_inc.pl */
+			if(strcasecmp(val, "hotp") == 0)
+				cur->type |= TOKEN_HOTP;
+		}
+	}
+	if(cur != NULL && token_check(file, cur) != 0)
+		goto fail;
+	return 0;
+
+syntax:
+	fprintf(stderr, "ERROR: %s:%lu: Syntax error\n", file,
+							(unsigned long)lineno);
+fail:
+	tokens_free(t);
+	return -1;
+}
+
+/* -- Token Store -- */
+
+static int tokens_load_store(struct tokens* t, const char* file, int fd)
+{
+	const struct store_header* h;
+	struct stat st;
+
+	if(fstat(fd, &st) != 0) {
+		perror(file);
+		return -1;
+	}
+	t->mapsz = st.st_size;
+	t->map = mmap(NULL, t->mapsz, PROT_READ, MAP_SHARED, fd, 0);
+	if(t->map == MAP_FAILED) {
+		t->map = NULL;
+		perror(file);
+		return -1;
+	}
+
+	h = t->map;
+	if(t->mapsz < sizeof(struct store_header)) {
+		fprintf(stderr, "ERROR: %s: Store truncated or corrupt\n",
+									file);
+		goto fail;
+	}
+	if(h->byteorder != STORE_BYTEORDER || h->version != STORE_VERSION ||
+				h->record_size != sizeof(struct token)) {
+		fprintf(stderr, "ERROR: %s: Unsupported store version %u "
+			"(record size %u) or byte order\n", file,
+			(unsigned)h->version, (unsigned)h->record_size);
+		goto fail;
+	}
+	if(h->num_records == 0 || h->table_size < h->num_records ||
+			(h->table_size & (h->table_size - 1)) != 0 ||
+			h->table_offset % 4 != 0 || h->records_offset % 4 != 0 ||
+			(uint64_t)h->table_offset + 4 * (uint64_t)h->table_size
+								> t->mapsz ||
+			(uint64_t)h->records_offset + (uint64_t)h->num_records *
+					sizeof(struct token) > t->mapsz) {
+		fprintf(stderr, "ERROR: %s: Store truncated or corrupt\n",
+									file);
+		goto fail;
+	}
+
+	t->tok = (const struct token*)((const char*)t->map +
+							h->records_offset);
+	t->len = h->num_records;
+	t->table = (const uint32_t*)((const char*)t->map + h->table_offset);
+	t->tablesz = h->table_size;
+	return 0;
+
+fail:
+	tokens_free(t);
+	return -1;
+}
+
+int tokens_load(struct tokens* t, const char* file)
+{
+	char magic[sizeof(STORE_MAGIC) - 1];
+	FILE* fd;
+	int rv;
+
+	memset(t, 0, sizeof(struct tokens));
+	if((fd = fopen(file, "r")) == NULL) {
+		perror(file);
+		return -1;
+	}
+	if(fread(magic, 1, sizeof(magic), fd) == sizeof(magic) &&
+			memcmp(magic, STORE_MAGIC, sizeof(magic)) == 0) {
+		rv = tokens_load_store(t, file, fileno(fd));
+	} else {
+		rewind(fd);
+		rv = tokens_load_ini(t, file, fd);
+	}
+	fclose(fd);
+	return rv;
+}
+
+/* -- Lookup -- */
+
+/* FNV-1a */
+static uint32_t name_hash(const char* name, size_t namelen)
+{
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	for(i = 0; i < namelen; i++) {
+		h ^= (unsigned char)name[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/* Index as written by secret_keys_to_inc.pl */
+static int tokens_index(struct tokens* t)
+{
+	size_t i;
+	size_t pos;
+
+	for(t->tablesz = 16; t->tablesz < 2 * t->len; t->tablesz *= 2)
+		;
+	if((t->owntable = calloc(t->tablesz, sizeof(uint32_t))) == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return -1;
+	}
+	t->table = t->owntable;
+
+	for(i = 0; i < t->len; i++) {
+		if(tokens_find(t, t->tok[i].name, strlen(t->tok[i].name)) >= 0) {
+			fprintf(stderr, "ERROR: Duplicate token [%s]\n",
+							t->tok[i].name);
+			return -1;
+		}
+		pos = name_hash(t->tok[i].name, strlen(t->tok[i].name));
+		for(pos &= t->tablesz - 1; t->owntable[pos] != 0;
+					pos = (pos + 1) & (t->tablesz - 1))
+			;
+		t->owntable[pos] = i + 1;
+	}
+	return 0;
+}
+
+int tokens_prepare(struct tokens* t)
+{
+	const unsigned char** keys;
+	unsigned char* keylens;
+	size_t* idx;
+	struct hotp_key* hk;
+	size_t num = 0;
+	size_t i;
+
+	/* store: midstate records, the index is in the mapping */
+	if(t->map != NULL)
+		return 0;
+
+	if(t->len == 0) {
+		fprintf(stderr, "ERROR: No tokens\n");
+		return -1;
+	}
+	if(tokens_index(t) != 0)
+		return -1;
+
+	keys    = malloc(t->len * sizeof(unsigned char*));
+	keylens = malloc(t->len);
+	idx     = malloc(t->len * sizeof(size_t));
+	hk      = malloc(t->len * sizeof(struct hotp_key));
+	if(keys == NULL || keylens == NULL || idx == NULL || hk == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		free(keys);
+		free(keylens);
+		free(idx);
+		free(hk);
+		return -1;
+	}
+
+	/* seeds become midstates as in a store */
+	for(i = 0; i < t->len; i++) {
+		if(!(t->own[i].type & TOKEN_MIDSTATE)) {
+			keys[num] = t->own[i].key;
+			keylens[num] = t->own[i].keylen;
+			idx[num++] = i;
+		}
+	}
+	if(num != 0)
+		hotp_batch_key(hk, keys, keylens, num);
+	for(i = 0; i < num; i++) {
+		memcpy(t->own[idx[i]].key, hk + i, sizeof(struct hotp_key));
+		t->own[idx[i]].type |= TOKEN_MIDSTATE;
+		t->own[idx[i]].keylen = 0;
+	}
+
+	free(keys);
+	free(keylens);
+	free(idx);
+	free(hk);
+	return 0;
+}
+
+long tokens_find(const struct tokens* t, const char* name, size_t namelen)
+{
+	size_t pos = name_hash(name, namelen) & (t->tablesz - 1);
+	const struct token* tok;
+	size_t n;
+
+	/* at most all slots: a store's table may be full */
+	for(n = 0; n < t->tablesz && t->table[pos] != 0; n++,
+					pos = (pos + 1) & (t->tablesz - 1)) {
+		if(t->table[pos] > t->len)
+			break;  /* corrupt store */
+		tok = t->tok + t->table[pos] - 1;
+		if(namelen < TOKEN_NAMELENGTH &&
+				strncmp(tok->name, name, namelen) == 0 &&
+				tok->name[namelen] == 0)
+			return (long)(t->table[pos] - 1);
+	}
+	return -1;
+}
+
+void tokens_free(struct tokens* t)
+{
+	if(t->map != NULL)
+		munmap(t->map, t->mapsz);
+	free(t->own);
+	free(t->owntable);
+	memset(t, 0, sizeof(struct tokens));
+}
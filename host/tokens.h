@@ -0,0 +1,92 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Token Table 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Tokens are records in the layout of struct db_entry in ../trtotp.c as
+ * compiled with KEY_MIDSTATES, but with keys in plain. They are read from
+ * a secretkeys.ini (section names, [global] skipped) or from a token store
+ * written by secret_keys_to_inc.pl --store. Stores are mapped as they are,
+ * records and index are used from the mapping without further processing.
+ * Only the header is checked, index entries when used and records not at
+ * all, i.e. a store is trusted like secretkeys.ini.
+ *
+ * The key of a TOKEN_MIDSTATE token is a struct hotp_key. Store records
+ * are always of this kind, .ini tokens after tokens_prepare.
+ *
+ * Token store, all integers little endian:
+ *
+ *	struct store_header
+ *	uint32_t index[table_size]          record index + 1, 0: empty
+ *	struct token records[num_records]
+ *
+ * The index is a hash table: slot FNV-1a(name) & (table_size - 1), then
+ * linear probing.
+ */
+
+/* requires hotp_batch.h */
+
+#define TOKEN_NAMELENGTH 16  /* max 15 chars + trailing 0 */
+#define TOKEN_MAXSEED    20  /* MAXKEYLENGTH, longer seeds as midstates */
+#define TOKEN_KEYFIELD   40  /* KEYFIELDLENGTH with KEY_MIDSTATES */
+#define TOKEN_MAXINI    300  /* longest seed in an .ini, Base32 fits a line */
+
+/* as TYPE_* in ../trtotp.c */
+#define TOKEN_TOTP       0
+#define TOKEN_HOTP       1
+#define TOKEN_MIDSTATE   2   /* key holds the ipad and opad SHA-1 states */
+
+/* HMAC key states of a token which has TOKEN_MIDSTATE */
+#define TOKEN_KEY(TOK) ((const struct hotp_key*)(TOK)->key)
+
+struct token {
+	char name[TOKEN_NAMELENGTH];
+	unsigned char type;
+	unsigned char keylen;
+	unsigned char timestep;
+	unsigned char digits;
+	unsigned char key[TOKEN_KEYFIELD];  /* 4 byte aligned */
+};
+
+#define STORE_MAGIC      "TRTOTPDB"
+#define STORE_BYTEORDER  0x01020304
+#define STORE_VERSION    2  /* 1: seeds, not midstates */
+
+struct store_header {
+	char magic[8];
+	uint32_t byteorder;       /* STORE_BYTEORDER */
+	uint16_t version;
+	uint16_t record_size;     /* sizeof(struct token) */
+	uint32_t num_records;
+	uint32_t table_size;      /* power of two */
+	uint32_t table_offset;
+	uint32_t records_offset;  /* multiple of 4 */
+};
+
+struct tokens {
+	const struct token* tok;
+	size_t len;
+	const uint32_t* table;
+	size_t tablesz;
+	void* map;                /* store mapping or NULL */
+	size_t mapsz;
+	struct token* own;        /* .ini: tok and table are allocated */
+	uint32_t* owntable;
+};
+
+/*
+ * Loads a token store or secretkeys.ini, whichever file is. Returns 0 on
+ * success, prints an error and returns -1 otherwise.
+ */
+int tokens_load(struct tokens* t, const char* file);
+
+/*
+ * For .ini: computes the HMAC key states and the index. Nothing to do for
+ * stores. 0 on success
+ */
+int tokens_prepare(struct tokens* t);
+
+/* Index of the token or -1 if not found, name need not be terminated */
+long tokens_find(const struct tokens* t, const char* name, size_t namelen);
+
+void tokens_free(struct tokens* t);
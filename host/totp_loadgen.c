@@ -0,0 +1,445 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Verification Load Generator 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Sends batches of requests to totp_verifyd and checks the responses. Each
+ * connection uses its own share of the tokens, round robin, such that no
+ * token occurs twice in a batch. Per token, valid codes are sent for steps
+ * now-W..now+W in ascending order (each is accepted once), then only for
+ * replays. Codes for BAD requests differ from all codes of the window.
+ * Daemon and load generator must agree on -t and -w and as the daemon keeps
+ * the replay state, it needs to be restarted for each run.
+ *
+ * Without -s, requests are written to stdout and the expected responses
+ * to the file given by -e, for piping into totp_verifyd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "hotp_batch.h"
+#include "latency.h"
+#include "tokens.h"
+
+#define DEFAULT_CONNECTIONS 1
+#define DEFAULT_BATCH       256
+#define DEFAULT_REQUESTS    100000
+#define DEFAULT_WINDOW      1
+#define DEFAULT_REPLAY      10
+#define DEFAULT_BAD         10
+#define MAX_WINDOW          16
+#define GEN_KEYLEN          20
+#define LINELENGTH          96
+
+struct token_state {
+	unsigned used;  /* valid codes sent */
+	uint32_t last;  /* last valid code sent */
+};
+
+struct conn {
+	unsigned idx;
+	pthread_t thread;
+	uint32_t rnd;
+	size_t requests;  /* to send */
+	size_t mismatches;
+	struct latency lat;
+	char* out;
+	char* expect;
+};
+
+static struct tokens tokens;
+static struct token_state* state;
+static unsigned num_conns = DEFAULT_CONNECTIONS;
+static size_t batch = DEFAULT_BATCH;
+static unsigned window = DEFAULT_WINDOW;
+static unsigned pct_replay = DEFAULT_REPLAY;
+static unsigned pct_bad = DEFAULT_BAD;
+static uint32_t now;
+static const char* sock = NULL;
+
+/* xorshift32, deterministic such that runs are comparable */
+static uint32_t rnd(uint32_t* x)
+{
+	*x ^= *x << 13;
+	*x ^= *x >> 17;
+	*x ^= *x << 5;
+	return *x;
+}
+
+static uint32_t code_for(size_t t, uint32_t counter)
+{
+	struct hotp_job job;
+	uint32_t code;
+
+	job.key = TOKEN_KEY(tokens.tok + t);
+	job.counter = counter;
+	job.digits = tokens.tok[t].digits;
+	hotp_batch(&code, &job, 1);
+	return code;
+}
+
+static uint32_t code_mod(size_t t)
+{
+	return (tokens.tok[t].digits == 8) ? 100000000 :
+			(tokens.tok[t].digits == 7) ? 10000000 : 1000000;
+}
+
+/* Counter of the next valid code, see totp_verifyd.c */
+static uint32_t valid_counter(size_t t, unsigned used)
+{
+	if(tokens.tok[t].type & TOKEN_HOTP)
+		return used;
+	else
+		return now / tokens.tok[t].timestep - window + used;
+}
+
+static int in_window(size_t t, uint32_t code)
+{
+	struct hotp_job jobs[2 * MAX_WINDOW + 1];
+	uint32_t codes[2 * MAX_WINDOW + 1];
+	unsigned n = 2 * window + 1;
+	unsigned k;
+
+	for(k = 0; k < n; k++) {
+		jobs[k].key = TOKEN_KEY(tokens.tok + t);
+		jobs[k].counter = (tokens.tok[t].type & TOKEN_HOTP) ?
+				(state[t].used - 1 + k) : valid_counter(t, k);
+		jobs[k].digits = tokens.tok[t].digits;
+	}
+	hotp_batch(codes, jobs, n);
+	for(k = 0; k < n; k++)
+		if(codes[k] == code)
+			return 1;
+	return 0;
+}
+
+/* Appends request and expected response for token t */
+static void gen_request(struct conn* c, size_t t, size_t* outlen,
+							size_t* explen)
+{
+	struct token_state* st = state + t;
+	unsigned kind = rnd(&c->rnd) % 100;
+	unsigned valid = (tokens.tok[t].type & TOKEN_HOTP) ? (unsigned)-1 :
+								2 * window + 1;
+	uint32_t code;
+
+	if(kind < pct_bad) {
+		do {
+			code = rnd(&c->rnd) % code_mod(t);
+		} while(in_window(t, code) || (st->used != 0 &&
+							code == st->last));
+		*explen += sprintf(c->expect + *explen, "BAD\n");
+	} else if(st->used != 0 && (kind < pct_bad + pct_replay ||
+							st->used == valid)) {
+		code = st->last;
+		*explen += sprintf(c->expect + *explen, "REPLAY\n");
+	} else {
+		code = code_for(t, valid_counter(t, st->used));
+		*explen += sprintf(c->expect + *explen, "OK %d\n",
+				(tokens.tok[t].type & TOKEN_HOTP) ? 0 :
+				(int)st->used - (int)window);
+		st->last = code;
+		st->used++;
+	}
+	*outlen += sprintf(c->out + *outlen, "%0*u %s\n",
+				tokens.tok[t].digits, code, tokens.tok[t].name);
+}
+
+static int write_all(int fd, const char* buf, size_t len)
+{
+	ssize_t rv;
+
+	while(len > 0) {
+		rv = write(fd, buf, len);
+		if(rv < 0 && errno == EINTR)
+			continue;
+		if(rv <= 0)
+			return -1;
+		buf += rv;
+		len -= rv;
+	}
+	return 0;
+}
+
+/* Reads until as many lines as expected arrived, then compares */
+static int read_responses(struct conn* c, int fd, char* in, size_t explen,
+								size_t num)
+{
+	size_t fill = 0;
+	size_t lines = 0;
+	size_t i;
+	size_t j;
+	ssize_t rv;
+
+	while(lines < num) {
+		if(fill == explen) {
+			/* longer than expected: count the rest as wrong */
+			c->mismatches += num - lines;
+			return 0;
+		}
+		rv = read(fd, in + fill, explen - fill);
+		if(rv < 0 && errno == EINTR)
+			continue;
+		if(rv <= 0)
+			return -1;
+		for(i = fill; i < fill + rv; i++)
+			lines += (in[i] == '\n');
+		fill += rv;
+	}
+
+	/* line by line, responses may differ in length */
+	for(i = 0, j = 0; i < fill && j < explen; ) {
+		if(strncmp(in + i, c->expect + j,
+				strchr(c->expect + j, '\n') - (c->expect + j) + 1)
+									!= 0)
+			c->mismatches++;
+		i = (char*)memchr(in + i, '\n', fill - i) - in + 1;
+		j = strchr(c->expect + j, '\n') - c->expect + 1;
+	}
+	return 0;
+}
+
+static void* conn_main(void* arg)
+{
+	struct conn* c = arg;
+	struct sockaddr_un addr;
+	char* in = malloc(batch * LINELENGTH);
+	size_t mine = (tokens.len - c->idx + num_conns - 1) / num_conns;
+	size_t next = 0;
+	size_t outlen;
+	size_t explen;
+	size_t num;
+	size_t i;
+	uint64_t t0;
+	int fd;
+
+	if(in == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return (void*)1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sock);
+	if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+			connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		perror(sock);
+		free(in);
+		return (void*)1;
+	}
+
+	while(c->requests > 0) {
+		num = (c->requests < batch) ? c->requests : batch;
+		outlen = 0;
+		explen = 0;
+		for(i = 0; i < num; i++) {
+			gen_request(c, c->idx + next * num_conns, &outlen,
+								&explen);
+			next = (next + 1) % mine;
+		}
+		c->requests -= num;
+
+		t0 = latency_now();
+		if(write_all(fd, c->out, outlen) != 0 ||
+				read_responses(c, fd, in, explen, num) != 0) {
+			fprintf(stderr, "ERROR: Connection %u lost\n", c->idx);
+			break;
+		}
+		latency_add(&c->lat, latency_now() - t0, 1);
+	}
+
+	close(fd);
+	free(in);
+	return (void*)(long)(c->requests != 0);
+}
+
+/* Without -s: requests to stdout, responses to expfile */
+static int gen_pipe(struct conn* c, FILE* expfile)
+{
+	size_t outlen;
+	size_t explen;
+	size_t num;
+	size_t next = 0;
+	size_t i;
+
+	while(c->requests > 0) {
+		num = (c->requests < batch) ? c->requests : batch;
+		outlen = 0;
+		explen = 0;
+		for(i = 0; i < num; i++) {
+			gen_request(c, next, &outlen, &explen);
+			next = (next + 1) % tokens.len;
+		}
+		c->requests -= num;
+		if(fwrite(c->out, 1, outlen, stdout) != outlen ||
+				(expfile != NULL && fwrite(c->expect, 1, explen,
+						expfile) != explen)) {
+			perror("write");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Random tokens for testing only, -g */
+static void gen_tokens(size_t n)
+{
+	static const char B32[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+	uint32_t x = 0x2545f491;
+	size_t i;
+	unsigned k;
+
+	/* for secret_keys_to_inc.pl --store */
+	printf("[global]\npassword=123456\n\n");
+	for(i = 0; i < n; i++) {
+		printf("[T%lu]\ntimestep=30\ndigits=%d\nkey=", (unsigned long)i,
+								6 + (int)(i % 3));
+		/* 32 Base32 characters are 20 bytes */
+		for(k = 0; k < GEN_KEYLEN * 8 / 5; k++)
+			putchar(B32[rnd(&x) % 32]);
+		printf("\n\n");
+	}
+}
+
+static void usage(const char* name)
+{
+	printf(
+"USAGE %s -g NUM\n"
+"USAGE %s [-s SOCKET | -e EXPECTFILE] [-c CONNECTIONS] [-b BATCH] "
+								"[-n REQUESTS]\n"
+"        [-w WINDOW] [-t UNIXTIME] [-r REPLAY%%] [-x BAD%%] TOKENS\n"
+"\n"
+" TOKENS  secretkeys.ini or token store as given to totp_verifyd\n"
+" -g  print NUM random tokens T0, T1, ... as secretkeys.ini\n"
+" -s  connect to totp_verifyd on Unix socket SOCKET, else write\n"
+"     requests to stdout and expected responses to EXPECTFILE\n"
+" -c  number of connections, default %d\n"
+" -b  requests per batch, default %d, at most tokens per connection\n"
+" -n  total number of requests, default %d\n"
+" -w  window as given to totp_verifyd, default %d\n"
+" -t  time as given to totp_verifyd, default: current time\n"
+" -r  percentage of replayed codes, default %d\n"
+" -x  percentage of wrong codes, default %d\n", name, name,
+		DEFAULT_CONNECTIONS, DEFAULT_BATCH, DEFAULT_REQUESTS,
+		DEFAULT_WINDOW, DEFAULT_REPLAY, DEFAULT_BAD);
+}
+
+int main(int argc, char** argv)
+{
+	size_t requests = DEFAULT_REQUESTS;
+	long fixed_time = -1;
+	const char* expname = NULL;
+	FILE* expfile = NULL;
+	struct conn* conns;
+	struct latency lat;
+	size_t mismatches = 0;
+	double seconds;
+	uint64_t t0;
+	void* trv;
+	unsigned i;
+	int opt;
+	int rv = 0;
+
+	while((opt = getopt(argc, argv, "g:s:e:c:b:n:w:t:r:x:h")) != -1) {
+		switch(opt) {
+		case 'g': gen_tokens(strtoul(optarg, NULL, 10)); return 0;
+		case 's': sock = optarg;                                 break;
+		case 'e': expname = optarg;                              break;
+		case 'c': num_conns = strtoul(optarg, NULL, 10);         break;
+		case 'b': batch = strtoul(optarg, NULL, 10);             break;
+		case 'n': requests = strtoul(optarg, NULL, 10);          break;
+		case 'w': window = strtoul(optarg, NULL, 10);            break;
+		case 't': fixed_time = strtol(optarg, NULL, 10);         break;
+		case 'r': pct_replay = strtoul(optarg, NULL, 10);        break;
+		case 'x': pct_bad = strtoul(optarg, NULL, 10);           break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(optind != argc - 1 || num_conns == 0 || batch == 0 ||
+				window > MAX_WINDOW || pct_replay + pct_bad > 100) {
+		usage(argv[0]);
+		return 1;
+	}
+	now = (fixed_time >= 0) ? (uint32_t)fixed_time : (uint32_t)time(NULL);
+
+	if(tokens_load(&tokens, argv[optind]) != 0 ||
+						tokens_prepare(&tokens) != 0)
+		return 1;
+	if(sock == NULL)
+		num_conns = 1;
+	if(num_conns > tokens.len)
+		num_conns = tokens.len;
+	if(batch > tokens.len / num_conns)
+		batch = tokens.len / num_conns;
+
+	state = calloc(tokens.len, sizeof(struct token_state));
+	conns = calloc(num_conns, sizeof(struct conn));
+	if(state == NULL || conns == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return 2;
+	}
+	for(i = 0; i < num_conns; i++) {
+		conns[i].idx = i;
+		conns[i].rnd = 0x2545f491 + i;
+		conns[i].requests = requests / num_conns +
+					(i < requests % num_conns);
+		conns[i].out = malloc(batch * LINELENGTH);
+		conns[i].expect = malloc(batch * LINELENGTH);
+		if(conns[i].out == NULL || conns[i].expect == NULL) {
+			fprintf(stderr, "ERROR: Out of memory\n");
+			return 2;
+		}
+	}
+
+	if(sock == NULL) {
+		if(expname != NULL && (expfile = fopen(expname, "w")) == NULL) {
+			perror(expname);
+			return 1;
+		}
+		rv = gen_pipe(conns, expfile);
+		if(expfile != NULL)
+			fclose(expfile);
+		return rv;
+	}
+
+	t0 = latency_now();
+	for(i = 0; i < num_conns; i++) {
+		if(pthread_create(&conns[i].thread, NULL, conn_main,
+							conns + i) != 0) {
+			fprintf(stderr, "ERROR: Failed to start connection\n");
+			return 2;
+		}
+	}
+	memset(&lat, 0, sizeof(lat));
+	for(i = 0; i < num_conns; i++) {
+		pthread_join(conns[i].thread, &trv);
+		rv |= (trv != NULL);
+		latency_merge(&lat, &conns[i].lat);
+		mismatches += conns[i].mismatches;
+	}
+	seconds = (latency_now() - t0) / 1e9;
+
+	printf("%lu requests in %.3f s, %.0f req/s, %u connections, "
+			"batch %lu\n", (unsigned long)requests, seconds,
+			requests / seconds, num_conns, (unsigned long)batch);
+	printf("batch round trip p50 %.1f us, p99 %.1f us, max %.1f us\n",
+			latency_percentile(&lat, 0.5) / 1e3,
+			latency_percentile(&lat, 0.99) / 1e3, lat.max / 1e3);
+	printf("%lu unexpected responses\n", (unsigned long)mismatches);
+	return (rv != 0 || mismatches != 0);
+}
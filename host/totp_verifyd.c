@@ -0,0 +1,674 @@
+/*
+ * Ma_Sys.ma TRTOTP Host Verification Daemon 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Verifies codes of the tokens in a secretkeys.ini or token store (see
+ * tokens.h). Requests are lines CODE NAME, read from stdin or clients of a
+ * Unix socket, each answered by one line in order: OK OFFSET, BAD, REPLAY,
+ * UNKNOWN or ERROR. All complete lines received with one read form a batch,
+ * it is split into tasks for the work stealing pool (pool.c) and answered at
+ * once. Requests for the same token are verified in the order received.
+ *
+ * TOTP codes are checked for steps now-W..now+W, nearest first. OFFSET is
+ * the matching step relative to now. As of RFC 6238 5.2, steps up to and
+ * including the last one accepted are REPLAY. HOTP codes are checked for
+ * the last counter accepted (REPLAY) and the 2W counters after it, OFFSET
+ * is the number of counters skipped. The state is not persisted, i.e. HOTP
+ * tokens start at counter 0 after each restart.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "hotp_batch.h"
+#include "latency.h"
+#include "pool.h"
+#include "tokens.h"
+
+#define DEFAULT_WINDOW 1
+#define MAX_WINDOW     16
+#define BUFSIZE        65536
+#define TASK_REQUESTS  64
+#define NUM_LOCKS      1024
+
+#define RES_OK         0
+#define RES_BAD        1
+#define RES_REPLAY     2
+#define RES_UNKNOWN    3
+#define RES_ERROR      4
+#define NUM_RES        5
+
+static const char* RES_NAMES[NUM_RES] = {
+	"OK", "BAD", "REPLAY", "UNKNOWN", "ERROR"
+};
+
+struct request {
+	long token;       /* -1: unknown */
+	uint32_t code;
+	unsigned char result;
+	int offset;
+};
+
+struct batch {
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	size_t remaining;  /* tasks */
+	uint32_t now;
+};
+
+struct verify_task {
+	struct pool_task base;
+	struct batch* batch;
+	struct request* req;  /* of the batch */
+	size_t* idx;          /* requests of this task */
+	size_t num;
+};
+
+/* per worker, TASK_REQUESTS * candidates each */
+struct scratch {
+	struct hotp_job* jobs;
+	uint32_t* codes;
+	uint32_t* steps;
+};
+
+/* -- Global State -- */
+
+static struct tokens tokens;
+static uint32_t* next_step;  /* per token, first step/counter not yet used */
+static pthread_mutex_t locks[NUM_LOCKS];  /* next_step, by token index */
+
+static struct pool pool;
+static struct scratch* scratch;
+static unsigned window = DEFAULT_WINDOW;
+static unsigned candidates;  /* 2 * window + 1 */
+static long fixed_time = -1;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct latency stats_latency;
+static uint64_t stats_res[NUM_RES];
+static uint64_t stats_first = 0;  /* ns, first batch received */
+static uint64_t stats_last = 0;   /* ns, last batch answered */
+
+static const char* socket_path = NULL;
+
+/* -- Verification -- */
+
+/*
+ * Candidates in order of preference. TOTP: now, now-1, now+1, now-2, ...
+ * HOTP: base-1 (only ever REPLAY), base, base+1, ...
+ */
+static uint32_t candidate(const struct token* tok, uint32_t base, unsigned k)
+{
+	if(tok->type & TOKEN_HOTP)
+		return base - 1 + k;
+	else if(k % 2 == 0)
+		return base + k / 2;
+	else
+		return base - (k + 1) / 2;
+}
+
+/*
+ * Checks the codes of candidates k0..candidates-1 of r, steps[k] and
+ * codes[k] for k = 0..candidates-1. Caller holds the token's lock.
+ */
+static void resolve(struct request* r, uint32_t base, const uint32_t* steps,
+							const uint32_t* codes)
+{
+	const struct token* tok = tokens.tok + r->token;
+	int replay = 0;
+	unsigned k;
+
+	r->result = RES_BAD;
+	for(k = 0; k < candidates; k++) {
+		/* steps/counters below 0 wrap around, never used */
+		if(codes[k] != r->code || steps[k] >
+					candidate(tok, base, candidates - 1))
+			continue;
+		if(steps[k] < next_step[r->token]) {
+			replay = 1;
+			continue;
+		}
+		r->result = RES_OK;
+		r->offset = (int)(steps[k] - base);
+		next_step[r->token] = steps[k] + 1;
+		return;
+	}
+	if(replay)
+		r->result = RES_REPLAY;
+}
+
+/* Counters depend on the previous request, hence one by one under lock */
+static void verify_hotp(struct request* r, struct scratch* s)
+{
+	const struct token* tok = tokens.tok + r->token;
+	pthread_mutex_t* lock = locks + r->token % NUM_LOCKS;
+	uint32_t base;
+	unsigned k;
+
+	pthread_mutex_lock(lock);
+	base = next_step[r->token];
+	for(k = 0; k < candidates; k++) {
+		s->steps[k] = candidate(tok, base, k);
+		s->jobs[k].key = TOKEN_KEY(tok);
+		s->jobs[k].counter = s->steps[k];
+		s->jobs[k].digits = tok->digits;
+	}
+	hotp_batch(s->codes, s->jobs, candidates);
+	resolve(r, base, s->steps, s->codes);
+	pthread_mutex_unlock(lock);
+}
+
+/* Up to TASK_REQUESTS TOTP requests, all candidates in one hotp_batch */
+static void verify_totp(struct request* req, const size_t* idx, size_t num,
+					uint32_t now, struct scratch* s)
+{
+	struct request* r;
+	const struct token* tok;
+	pthread_mutex_t* lock;
+	uint32_t base[TASK_REQUESTS];
+	size_t njobs = 0;
+	size_t i;
+	unsigned k;
+
+	for(i = 0; i < num; i++) {
+		r = req + idx[i];
+		tok = tokens.tok + r->token;
+		base[i] = now / tok->timestep;
+		for(k = 0; k < candidates; k++) {
+			s->steps[njobs] = candidate(tok, base[i], k);
+			s->jobs[njobs].key = TOKEN_KEY(tok);
+			s->jobs[njobs].counter = s->steps[njobs];
+			s->jobs[njobs].digits = tok->digits;
+			njobs++;
+		}
+	}
+	hotp_batch(s->codes, s->jobs, njobs);
+
+	for(i = 0; i < num; i++) {
+		r = req + idx[i];
+		lock = locks + r->token % NUM_LOCKS;
+		pthread_mutex_lock(lock);
+		resolve(r, base[i], s->steps + i * candidates,
+						s->codes + i * candidates);
+		pthread_mutex_unlock(lock);
+	}
+}
+
+static void verify_run(struct pool_task* task, unsigned worker)
+{
+	struct verify_task* vt = (struct verify_task*)task;
+	struct scratch* s = scratch + worker;
+	size_t totp[TASK_REQUESTS];
+	size_t num = 0;
+	size_t i;
+
+	/* in order, TOTP requests are collected until the next HOTP one */
+	for(i = 0; i < vt->num; i++) {
+		if(tokens.tok[vt->req[vt->idx[i]].token].type & TOKEN_HOTP) {
+			if(num != 0)
+				verify_totp(vt->req, totp, num, vt->batch->now, s);
+			num = 0;
+			verify_hotp(vt->req + vt->idx[i], s);
+			continue;
+		}
+		totp[num++] = vt->idx[i];
+		if(num == TASK_REQUESTS) {
+			verify_totp(vt->req, totp, num, vt->batch->now, s);
+			num = 0;
+		}
+	}
+	if(num != 0)
+		verify_totp(vt->req, totp, num, vt->batch->now, s);
+
+	pthread_mutex_lock(&vt->batch->lock);
+	if(--vt->batch->remaining == 0)
+		pthread_cond_signal(&vt->batch->done);
+	pthread_mutex_unlock(&vt->batch->lock);
+}
+
+/* Out of memory in pool_submit */
+static void fail_task(struct verify_task* vt)
+{
+	size_t i;
+
+	for(i = 0; i < vt->num; i++)
+		vt->req[vt->idx[i]].result = RES_ERROR;
+	pthread_mutex_lock(&vt->batch->lock);
+	vt->batch->remaining--;
+	pthread_mutex_unlock(&vt->batch->lock);
+}
+
+/* -- Requests -- */
+
+/* CODE NAME, returns 0 if the line is not a request */
+static int parse_request(char* line, size_t len, struct request* r)
+{
+	char* end = line + len;
+	char* name;
+	unsigned digits = 0;
+
+	while(end > line && isspace((unsigned char)end[-1]))
+		end--;
+	while(line < end && isspace((unsigned char)*line))
+		line++;
+	if(line == end)
+		return 0;
+
+	r->token = -1;
+	r->code = 0;
+	r->offset = 0;
+	r->result = RES_UNKNOWN;
+	for(; line < end && isdigit((unsigned char)*line); line++, digits++)
+		r->code = r->code * 10 + (*line - '0');
+	for(name = line; name < end && isspace((unsigned char)*name); name++)
+		;
+	if(digits < 6 || digits > 8 || name == line || name == end) {
+		r->result = RES_ERROR;
+		return 1;
+	}
+	r->token = tokens_find(&tokens, name, end - name);
+	/* leading zeros are part of the code, its length must match */
+	if(r->token >= 0 && tokens.tok[r->token].digits != digits) {
+		r->token = -1;
+		r->result = RES_BAD;
+	}
+	return 1;
+}
+
+static uint32_t current_time()
+{
+	return (fixed_time >= 0) ? (uint32_t)fixed_time : (uint32_t)time(NULL);
+}
+
+static int write_all(int fd, const char* buf, size_t len)
+{
+	ssize_t rv;
+
+	while(len > 0) {
+		rv = write(fd, buf, len);
+		if(rv < 0 && errno == EINTR)
+			continue;
+		if(rv <= 0)
+			return -1;
+		buf += rv;
+		len -= rv;
+	}
+	return 0;
+}
+
+static void batch_stats(const struct request* req, size_t num,
+						uint64_t t_in, uint64_t t_out)
+{
+	size_t i;
+
+	pthread_mutex_lock(&stats_lock);
+	if(stats_first == 0)
+		stats_first = t_in;
+	stats_last = t_out;
+	latency_add(&stats_latency, t_out - t_in, num);
+	for(i = 0; i < num; i++)
+		stats_res[req[i].result]++;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/*
+ * Verifies all requests, returns the number of bytes of responses. Tasks
+ * get the requests by token, i.e. requests for the same token are verified
+ * in order by the same task.
+ */
+static size_t process_batch(struct request* req, size_t num,
+			struct verify_task* tasks, size_t* idx, char* out)
+{
+	struct batch b;
+	size_t ntasks = (num + TASK_REQUESTS - 1) / TASK_REQUESTS;
+	size_t outlen = 0;
+	size_t pos = 0;
+	size_t i;
+
+	pthread_mutex_init(&b.lock, NULL);
+	pthread_cond_init(&b.done, NULL);
+	b.now = current_time();
+	b.remaining = 0;
+
+	for(i = 0; i < ntasks; i++)
+		tasks[i].num = 0;
+	for(i = 0; i < num; i++)
+		if(req[i].token >= 0)
+			tasks[req[i].token % ntasks].num++;
+	for(i = 0; i < ntasks; i++) {
+		tasks[i].idx = idx + pos;
+		pos += tasks[i].num;
+		tasks[i].num = 0;
+	}
+	for(i = 0; i < num; i++)
+		if(req[i].token >= 0)
+			tasks[req[i].token % ntasks].idx[
+				tasks[req[i].token % ntasks].num++] = i;
+
+	for(i = 0; i < ntasks; i++)
+		b.remaining += (tasks[i].num != 0);
+	for(i = 0; i < ntasks; i++) {
+		if(tasks[i].num == 0)
+			continue;
+		tasks[i].base.run = verify_run;
+		tasks[i].batch = &b;
+		tasks[i].req = req;
+		if(pool_submit(&pool, &tasks[i].base) != 0)
+			fail_task(&tasks[i]);
+	}
+
+	pthread_mutex_lock(&b.lock);
+	while(b.remaining != 0)
+		pthread_cond_wait(&b.done, &b.lock);
+	pthread_mutex_unlock(&b.lock);
+	pthread_mutex_destroy(&b.lock);
+	pthread_cond_destroy(&b.done);
+
+	for(i = 0; i < num; i++) {
+		if(req[i].result == RES_OK)
+			outlen += sprintf(out + outlen, "OK %d\n",
+							req[i].offset);
+		else
+			outlen += sprintf(out + outlen, "%s\n",
+						RES_NAMES[req[i].result]);
+	}
+	return outlen;
+}
+
+/* Handles one client until EOF, returns 0 on success */
+static int serve(int fdin, int fdout)
+{
+	/* a request is at least 2 bytes (ERROR), a response at most 8 */
+	const size_t maxreq = BUFSIZE / 2;
+	char* buf = malloc(BUFSIZE);
+	char* out = malloc(maxreq * 8 + 1);  /* sprintf NUL */
+	struct request* req = malloc(maxreq * sizeof(struct request));
+	struct verify_task* tasks = malloc((maxreq / TASK_REQUESTS + 1) *
+						sizeof(struct verify_task));
+	size_t* idx = malloc(maxreq * sizeof(size_t));
+	size_t fill = 0;
+	size_t num;
+	size_t pos;
+	size_t outlen;
+	char* nl;
+	uint64_t t_in;
+	ssize_t rv;
+	int err = 0;
+
+	if(buf == NULL || out == NULL || req == NULL || tasks == NULL ||
+								idx == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		err = -1;
+		goto done;
+	}
+
+	for(;;) {
+		rv = read(fdin, buf + fill, BUFSIZE - fill);
+		if(rv < 0 && errno == EINTR)
+			continue;
+		if(rv <= 0)
+			break;
+		t_in = latency_now();
+		fill += rv;
+
+		num = 0;
+		pos = 0;
+		while((nl = memchr(buf + pos, '\n', fill - pos)) != NULL) {
+			num += parse_request(buf + pos, nl - (buf + pos),
+								req + num);
+			pos = nl - buf + 1;
+		}
+		if(pos == 0 && fill == BUFSIZE) {
+			fprintf(stderr, "ERROR: Request line too long\n");
+			err = -1;
+			break;
+		}
+		memmove(buf, buf + pos, fill - pos);
+		fill -= pos;
+		if(num == 0)
+			continue;
+
+		outlen = process_batch(req, num, tasks, idx, out);
+		if(write_all(fdout, out, outlen) != 0) {
+			err = -1;
+			break;
+		}
+		batch_stats(req, num, t_in, latency_now());
+	}
+
+done:
+	free(buf);
+	free(out);
+	free(req);
+	free(tasks);
+	free(idx);
+	return err;
+}
+
+static void* client_main(void* arg)
+{
+	int fd = (int)(long)arg;
+	serve(fd, fd);
+	close(fd);
+	return NULL;
+}
+
+/* -- Statistics and Signals -- */
+
+static void report()
+{
+	double seconds;
+	uint64_t total = 0;
+	unsigned i;
+
+	pthread_mutex_lock(&stats_lock);
+	for(i = 0; i < NUM_RES; i++)
+		total += stats_res[i];
+	seconds = (stats_last - stats_first) / 1e9;
+	fprintf(stderr, "%llu requests in %.3f s, %.0f req/s, latency "
+			"p50 %.1f us, p99 %.1f us, max %.1f us\n",
+			(unsigned long long)total, seconds,
+			(seconds > 0) ? total / seconds : 0.0,
+			latency_percentile(&stats_latency, 0.5) / 1e3,
+			latency_percentile(&stats_latency, 0.99) / 1e3,
+			stats_latency.max / 1e3);
+	for(i = 0; i < NUM_RES; i++)
+		fprintf(stderr, "%s%s %llu", (i == 0) ? "" : ", ",
+			RES_NAMES[i], (unsigned long long)stats_res[i]);
+	fprintf(stderr, "\n");
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/* SIGUSR1: report, SIGINT/SIGTERM: report and exit */
+static void* signal_main(void* arg)
+{
+	sigset_t* set = arg;
+	int sig;
+
+	for(;;) {
+		if(sigwait(set, &sig) != 0)
+			continue;
+		report();
+		if(sig != SIGUSR1) {
+			if(socket_path != NULL)
+				unlink(socket_path);
+			exit(0);
+		}
+	}
+	return NULL;
+}
+
+static int serve_socket(const char* path)
+{
+	struct sockaddr_un addr;
+	pthread_t thread;
+	int lfd;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "ERROR: Socket path too long: %s\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	if((lfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return -1;
+	}
+	unlink(path);
+	/* only the owner may ask for verifications */
+	umask(077);
+	if(bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+						listen(lfd, 64) != 0) {
+		perror(path);
+		close(lfd);
+		return -1;
+	}
+	socket_path = path;
+
+	for(;;) {
+		if((fd = accept(lfd, NULL, NULL)) < 0) {
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			perror("accept");
+			break;
+		}
+		if(pthread_create(&thread, NULL, client_main, (void*)(long)fd)
+									!= 0) {
+			fprintf(stderr, "ERROR: Failed to start client "
+								"thread\n");
+			close(fd);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+	close(lfd);
+	unlink(path);
+	return -1;
+}
+
+/* -- Main -- */
+
+static void usage(const char* name)
+{
+	printf(
+"USAGE %s [-s SOCKET] [-j THREADS] [-w WINDOW] [-t UNIXTIME] [-i IMPL] "
+								"TOKENS\n"
+"\n"
+" TOKENS  secretkeys.ini or token store by secret_keys_to_inc.pl --store\n"
+" -s  listen on Unix socket SOCKET instead of reading stdin\n"
+" -j  number of worker threads, default: number of CPUs\n"
+" -w  accept steps now-WINDOW..now+WINDOW (HOTP: 2*WINDOW counters),\n"
+"     default %d\n"
+" -t  use UNIXTIME instead of the current time\n"
+" -i  hotp_batch implementation (scalar, sse2, avx2 or avx512)\n"
+"\n"
+"Requests are lines CODE NAME, answered by OK OFFSET, BAD, REPLAY,\n"
+"UNKNOWN or ERROR. SIGUSR1 prints statistics, SIGINT/SIGTERM too and exit.\n",
+						name, DEFAULT_WINDOW);
+}
+
+int main(int argc, char** argv)
+{
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char* sock = NULL;
+	const char* impl = NULL;
+	sigset_t sigs;
+	pthread_t sigthread;
+	unsigned i;
+	int opt;
+	int rv;
+
+	while((opt = getopt(argc, argv, "s:j:w:t:i:h")) != -1) {
+		switch(opt) {
+		case 's': sock = optarg;                           break;
+		case 'j': num_threads = strtol(optarg, NULL, 10);  break;
+		case 'w': window = strtoul(optarg, NULL, 10);      break;
+		case 't': fixed_time = strtol(optarg, NULL, 10);   break;
+		case 'i': impl = optarg;                           break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(optind != argc - 1 || num_threads < 1 || window > MAX_WINDOW) {
+		usage(argv[0]);
+		return 1;
+	}
+	if(impl != NULL && !hotp_batch_select(impl)) {
+		fprintf(stderr, "ERROR: Implementation %s not supported\n",
+									impl);
+		return 1;
+	}
+	candidates = 2 * window + 1;
+
+	if(tokens_load(&tokens, argv[optind]) != 0 ||
+						tokens_prepare(&tokens) != 0)
+		return 1;
+	fprintf(stderr, "%lu tokens, %ld threads, hotp_batch %s\n",
+				(unsigned long)tokens.len, num_threads,
+				hotp_batch_impl());
+
+	next_step = calloc(tokens.len, sizeof(uint32_t));
+	scratch = calloc(num_threads, sizeof(struct scratch));
+	if(next_step == NULL || scratch == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return 2;
+	}
+	for(i = 0; i < num_threads; i++) {
+		scratch[i].jobs = malloc(TASK_REQUESTS * candidates *
+						sizeof(struct hotp_job));
+		scratch[i].codes = malloc(TASK_REQUESTS * candidates *
+							sizeof(uint32_t));
+		scratch[i].steps = malloc(TASK_REQUESTS * candidates *
+							sizeof(uint32_t));
+		if(scratch[i].jobs == NULL || scratch[i].codes == NULL ||
+						scratch[i].steps == NULL) {
+			fprintf(stderr, "ERROR: Out of memory\n");
+			return 2;
+		}
+	}
+	for(i = 0; i < NUM_LOCKS; i++)
+		pthread_mutex_init(locks + i, NULL);
+
+	/* all threads inherit the mask, signals go to signal_main only */
+	signal(SIGPIPE, SIG_IGN);
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGTERM);
+	sigaddset(&sigs, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+	if(pthread_create(&sigthread, NULL, signal_main, &sigs) != 0 ||
+				pool_start(&pool, num_threads) != 0) {
+		fprintf(stderr, "ERROR: Failed to start threads\n");
+		return 2;
+	}
+
+	if(sock != NULL) {
+		rv = serve_socket(sock);
+	} else {
+		rv = serve(0, 1);
+		report();
+	}
+
+	pool_stop(&pool);
+	return (rv == 0) ? 0 : 1;
+}
@@ -24,11 +24,28 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
-static void hotp(unsigned char* key, unsigned char keylen,
-			unsigned long count, unsigned char digits,
-			unsigned long* out)
+static void hotp(const unsigned char* key, unsigned char keylen,
+			UINT4 count, unsigned char digits,
+			UINT4* out)
+{
+	HMAC_CTX ctx;
+
+	hmac_sha1_key(&ctx, key, keylen);
+	hotp_ctx(&ctx, count, digits, out);
+}
+
+static void hotp_ctx(const HMAC_CTX* ctx, UINT4 count,
+				unsigned char digits, UINT4* out)
+{
+	unsigned char innerhash[20];
+
+	hotp_inner(ctx, count, innerhash);
+	hotp_outer(ctx, innerhash, digits, out);
+}
+
+static void hotp_inner(const HMAC_CTX* ctx, UINT4 count,
+						unsigned char* innerhash)
 {
-	unsigned char digest[20];
 	unsigned char bytes[8];
 
 	memset(bytes, 0, 4);
@@ -37,19 +54,27 @@ static void hotp(unsigned char* key, unsigned char keylen,
 	bytes[6] = (count >>  8) & 0xff;
 	bytes[7] = (count      ) & 0xff;
 
-	hmac_sha1(key, keylen, bytes, sizeof(bytes), digest);
-	/*hmac_sha1(digest, key, bytes, keylen);*/
+	hmac_sha1_inner(ctx, bytes, sizeof(bytes), innerhash);
+}
+
+static void hotp_outer(const HMAC_CTX* ctx, const unsigned char* innerhash,
+				unsigned char digits, UINT4* out)
+{
+	unsigned char digest[20];
+
+	TRACE(TRACE_HOTP);
+	hmac_sha1_outer(ctx, innerhash, digest);
 
 	/*
 	 * Truncate digest based on the RFC4226 Standard
 	 * https://tools.ietf.org/html/rfc4226#section-5.4
 	 */
 	unsigned char offset = digest[19] & 0xf;
-	unsigned long bin_code =
-		(unsigned long)(digest[offset]     & 0x7f) << 24 |
-		(unsigned long)(digest[offset + 1] & 0xff) << 16 |
-		(unsigned long)(digest[offset + 2] & 0xff) <<  8 |
-		(unsigned long)(digest[offset + 3] & 0xff);
+	UINT4 bin_code =
+		(UINT4)(digest[offset]     & 0x7f) << 24 |
+		(UINT4)(digest[offset + 1] & 0xff) << 16 |
+		(UINT4)(digest[offset + 2] & 0xff) <<  8 |
+		(UINT4)(digest[offset + 3] & 0xff);
 
 	/*
 	 * Specification says that the implementation MUST return
@@ -1,3 +1,11 @@
-static void hotp(unsigned char* key, unsigned char keylen,
-			unsigned long count, unsigned char digits,
-			unsigned long* out);
+static void hotp(const unsigned char* key, unsigned char keylen,
+			UINT4 count, unsigned char digits,
+			UINT4* out);
+/* same with the key already set up by hmac_sha1_key */
+static void hotp_ctx(const HMAC_CTX* ctx, UINT4 count,
+				unsigned char digits, UINT4* out);
+/* hotp_ctx in two steps of one SHA-1 block each, innerhash has 20 bytes */
+static void hotp_inner(const HMAC_CTX* ctx, UINT4 count,
+						unsigned char* innerhash);
+static void hotp_outer(const HMAC_CTX* ctx, const unsigned char* innerhash,
+				unsigned char digits, UINT4* out);
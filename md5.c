@@ -0,0 +1,124 @@
+/*
+ * Ma_Sys.ma TRTOTP MD5 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ */
+
+#include <string.h>
+
+#include "md5.h"
+
+static const uint32_t K[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+	0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+	0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+	0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+	0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+	0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+	0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+	0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+	0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const uint8_t S[64] = {
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static void md5_transform(uint32_t state[4], const uint8_t block[64])
+{
+	uint32_t m[16];
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	uint32_t f, t;
+	unsigned i, g;
+
+	for(i = 0; i < 16; i++)
+		m[i] = block[i * 4] | (block[i * 4 + 1] << 8) |
+			(block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+
+	for(i = 0; i < 64; i++) {
+		if(i < 16) {
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if(i < 32) {
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) & 15;
+		} else if(i < 48) {
+			f = b ^ c ^ d;
+			g = (3 * i + 5) & 15;
+		} else {
+			f = c ^ (b | ~d);
+			g = (7 * i) & 15;
+		}
+		t = d;
+		d = c;
+		c = b;
+		f += a + K[i] + m[g];
+		b += (f << S[i]) | (f >> (32 - S[i]));
+		a = t;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+
+void md5_init(struct md5_ctx* ctx)
+{
+	ctx->state[0] = 0x67452301;
+	ctx->state[1] = 0xefcdab89;
+	ctx->state[2] = 0x98badcfe;
+	ctx->state[3] = 0x10325476;
+	ctx->count = 0;
+}
+
+void md5_update(struct md5_ctx* ctx, const void* data, size_t len)
+{
+	const uint8_t* in = data;
+	size_t have = ctx->count & 63;
+	size_t take;
+
+	ctx->count += len;
+	while(len > 0) {
+		take = 64 - have;
+		if(take > len)
+			take = len;
+		memcpy(ctx->buffer + have, in, take);
+		have += take;
+		in   += take;
+		len  -= take;
+		if(have == 64) {
+			md5_transform(ctx->state, ctx->buffer);
+			have = 0;
+		}
+	}
+}
+
+void md5_final(uint8_t out[16], struct md5_ctx* ctx)
+{
+	static const uint8_t PAD[64] = { 0x80 };
+	uint8_t bits[8];
+	uint64_t nbits = ctx->count << 3;
+	size_t padlen = ((ctx->count & 63) < 56) ? (56 - (ctx->count & 63)) :
+						(120 - (ctx->count & 63));
+	unsigned i;
+
+	for(i = 0; i < 8; i++)
+		bits[i] = (nbits >> (8 * i)) & 0xff;
+
+	md5_update(ctx, PAD, padlen);
+	md5_update(ctx, bits, 8);
+
+	for(i = 0; i < 16; i++)
+		out[i] = (ctx->state[i / 4] >> (8 * (i % 4))) & 0xff;
+}
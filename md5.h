@@ -0,0 +1,22 @@
+/*
+ * Ma_Sys.ma TRTOTP MD5 1.0.0,
+ * Copyright (c) 2021 Ma_Sys.ma.
+ * For further info send an e-mail to Ma_Sys.ma@web.de.
+ *
+ * Plain RFC 1321 MD5 used to stand in for the OS MD5Init/MD5Update/MD5Final
+ * routines of the TI-84+ where they are not available: in the emulator
+ * (emu/) and on the TI-84 Plus CE (ce/).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct md5_ctx {
+	uint32_t state[4];
+	uint64_t count;        /* bytes processed */
+	uint8_t buffer[64];
+};
+
+void md5_init(struct md5_ctx* ctx);
+void md5_update(struct md5_ctx* ctx, const void* data, size_t len);
+void md5_final(uint8_t out[16], struct md5_ctx* ctx);
@@ -8,18 +8,31 @@ use warnings FATAL => 'all';
 use autodie;
 
 use Digest::MD5 qw(md5);      # standard
+use Digest::SHA qw(sha1);     # standard
 require Config::INI::Reader;  # DEPENDS libconfig-ini-perl
 require MIME::Base32;         # DEPENDS libmime-base32-perl
 
 # use Data::Dumper;           # DEBUG ONLY
 
 if($#ARGV < 0 or $ARGV[0] eq "--help") {
-	print "USAGE $0 secrets.ini > keys.inc\n";
+	print "USAGE $0 [--store tokens.tts] secrets.ini > keys.inc\n";
 	exit(1);
 }
 
+# token store for the host tools -> host/tokens.h
+my $store;
+if($ARGV[0] eq "--store") {
+	shift(@ARGV);
+	$store = shift(@ARGV);
+}
+
 my $ini = Config::INI::Reader->read_file($ARGV[0]);
 my $password = $ini->{global}->{password};
+my $iterations = $ini->{global}->{iterations} // 0;
+# -> trtotp.c KDFITERATIONS is an unsigned int, i.e. 16 bit with sdcc
+die("iterations must be 0-65535\n")
+		if($iterations !~ /^[0-9]+$/ or $iterations > 65535);
+my $midstates = $ini->{global}->{midstates} // 0;
 delete $ini->{global};
 
 # Currently hard-coded length of 20. See C code for the implementation that
@@ -37,13 +50,63 @@ my $pwin  = $password.substr($paddingstr, length($password));
 my $hash1 = md5($pwin);
 my $hash2 = md5($hash1);
 my $toxor = $hash1.substr($hash2, 0, $MAXKEYLENGTH - 16);
+# key stretching -> trtotp.c sha_iterate
+$toxor = sha1($toxor) for(1..$iterations);
+# pad for the opad states -> trtotp.c set_decryption_key
+$toxor .= sha1($toxor) if($midstates);
 
 my @chars = unpack("C*", substr($toxor, 0, 1));
 print "/* ".$chars[0]." */\n";
+print "#define KDF_ITERATIONS $iterations\n";
+print "#ifndef KEY_MIDSTATES\n".
+	"#error keys.inc holds HMAC midstates, compile with -DKEY_MIDSTATES\n".
+	"#endif\n" if($midstates);
+
+# SHA-1 chaining values after the HMAC key ^ pad block, big endian
+# -> hmac-sha1.c hmac_sha1_midstate
+sub midstate {
+	my ($hmackey, $pad) = @_;
+	my $sha = Digest::SHA->new(1);
+	# shorter key is extended by 0 bytes, i.e. the block by pad bytes
+	$sha->add($hmackey ^ (chr($pad) x 64));
+	my ($state) = $sha->getstate =~ /^H:(.*)$/m;
+	return pack("H*", join("", (split(/:/, $state))[0..4]));
+}
 
+my @records;
 for my $entry (sort keys %{$ini}) {
 	my $decoded = MIME::Base32::decode_base32($ini->{$entry}->{key});
-	my $encrypted = $toxor ^ $decoded;
+	# -> trtotp.c TYPE_TOTP, TYPE_HOTP, TYPE_MIDSTATE
+	my $type = lc($ini->{$entry}->{type} // "totp") eq "hotp" ? 1 : 0;
+	my $keylen = length($decoded);
+	my $plain = $decoded;
+	# RFC 2104: keys longer than the block are hashed first
+	my $hmackey = ($keylen > 64) ? sha1($decoded) : $decoded;
+	my $states = midstate($hmackey, 0x36).midstate($hmackey, 0x5c);
+	if($midstates) {
+		$plain = $states;
+		$type |= 2;
+		$keylen = 0; # unused
+	} elsif($keylen > $MAXKEYLENGTH) {
+		die("[$entry]: Seeds longer than $MAXKEYLENGTH bytes need ".
+						"midstates=1\n");
+	}
+	my $timestep = $ini->{$entry}->{timestep} // 0;
+	if(defined($store)) {
+		die("[$entry]: Names are limited to 15 characters\n")
+							if(length($entry) > 15);
+		# host tools do not check the records of a store
+		my $digits = $ini->{$entry}->{digits} // "";
+		die("[$entry]: digits must be 6-8\n")
+						if($digits !~ /^[678]$/);
+		# host/tokens.h struct token, always midstates as little endian
+		# words (struct hotp_key), host tools divide by the timestep
+		# also for TOTP entries without one
+		push(@records, pack("a16 C C C C a40", $entry, $type | 2, 0,
+				$timestep || 30, $digits,
+				pack("V*", unpack("N*", $states))));
+	}
+	my $encrypted = $toxor ^ $plain;
 	# https://stackoverflow.com/questions/13158976/split-binary-data-into-
 	my @bytes = unpack "C*", $encrypted;
 	# -> trtotp.c
@@ -53,10 +116,36 @@ for my $entry (sort keys %{$ini}) {
 	# 	unsigned char keylen;
 	# 	unsigned char timestep;
 	# 	unsigned char digits;
-	# 	unsigned char key[MAXKEYLENGTH]; /* encrypted */
+	# 	unsigned char key[KEYFIELDLENGTH]; /* encrypted */
 	# };
-	print "{\"$entry\", 0, ".length($decoded).", ".
-		$ini->{$entry}->{timestep}.", ".
+	print "{\"$entry\", $type, $keylen, $timestep, ".
 		$ini->{$entry}->{digits}.", {".
 		join(",", map { sprintf("0x%02x", $_); } @bytes)."},},\n";
 }
+
+# -> host/tokens.h FNV-1a
+sub name_hash {
+	use integer;
+	my $h = 2166136261;
+	$h = (($h ^ $_) * 16777619) & 0xffffffff for(unpack("C*", $_[0]));
+	return $h;
+}
+
+if(defined($store)) {
+	my $tablesz = 16;
+	$tablesz *= 2 while($tablesz < 2 * @records);
+	my @table = (0) x $tablesz;
+	for my $i (0..$#records) {
+		my $pos = name_hash(unpack("Z16", $records[$i])) &
+								($tablesz - 1);
+		$pos = ($pos + 1) & ($tablesz - 1) while($table[$pos]);
+		$table[$pos] = $i + 1;
+	}
+	# struct store_header
+	open(my $fd, ">:raw", $store);
+	print $fd pack("a8 V v v V V V V", "TRTOTPDB", 0x01020304, 2, 60,
+			scalar(@records), $tablesz, 32, 32 + 4 * $tablesz);
+	print $fd pack("V*", @table);
+	print $fd @records;
+	close($fd);
+}
@@ -83,8 +83,7 @@
 /* POINTER defines a generic pointer type */
 typedef unsigned char *POINTER;
 
-/* UINT4 defines a four byte word */
-typedef unsigned long UINT4;
+/* UINT4 defines a four byte word, see sha1.h */
 
 /* BYTE defines a unsigned character */
 typedef unsigned char BYTE;
@@ -140,10 +139,23 @@ static UINT4 f3(UINT4 x, UINT4 y, UINT4 z)
 	return ((x & y) | (z & (x | y)));
 }
 
-/* 32-bit rotate left - kludged with shifts */
-static UINT4 ROTL(int n, UINT4 X)
+/*
+ * 32-bit rotates by the constant amounts SHA-1 needs. A generic rotate with
+ * a variable amount compiles to sdcc's __rlulong/__rrulong loops which cost
+ * 32 single-bit shifts per rotate. With constant amounts, sdcc emits byte
+ * moves and few inline shifts instead.
+ */
+static UINT4 rotl1(UINT4 X)
+{
+	return ((X << 1) | (X >> 31));
+}
+static UINT4 rotl5(UINT4 X)
 {
-	return (((X) << n) | ((X) >> (32 - n)));
+	return ((X << 5) | (X >> 27));
+}
+static UINT4 rotl30(UINT4 X)
+{
+	return ((X << 30) | (X >> 2));
 }
 
 /*
@@ -176,6 +188,9 @@ static void sha_init(SHA_CTX* shs_info)
 	shs_info->countLo = shs_info->countHi = 0;
 }
 
+#ifdef TRTOTP_CE
+#include "ce/sha1_ez80.c"
+#else
 /*
  * Perform the SHS transformation.  Note that this code, like MD5, seems to
  * break some optimizing compilers due to the complexity of the expressions
@@ -191,10 +206,12 @@ static void shs_transform(UINT4* digest, UINT4* in)
 {
 	byte i;
 
+	TRACE(TRACE_SHS);
+
     	memcpy(W, in, 64);
 
 	for(i = 0; i < 64; i++)
-		W[i+16] = ROTL(1, W[i+13] ^ W[i+8] ^ W[i+2] ^ W[i]);
+		W[i+16] = rotl1(W[i+13] ^ W[i+8] ^ W[i+2] ^ W[i]);
 
 	a = digest[0];
 	b = digest[1];
@@ -203,37 +220,37 @@ static void shs_transform(UINT4* digest, UINT4* in)
 	e = digest[4];
 
 	for(i = 0; i < 20; i++) {
-		t = f1(b, c, d) + K1 + ROTL(5, a) + e + W[i];
+		t = f1(b, c, d) + K1 + rotl5(a) + e + W[i];
 		e = d;
 		d = c;
-		c = ROTL(30, b);
+		c = rotl30(b);
 		b = a;
 		a = t;
 	}
 
 	for(; i < 40; i++) {
-		t = f2(b, c, d) + K2 + ROTL(5, a) + e + W[i];
+		t = f2(b, c, d) + K2 + rotl5(a) + e + W[i];
 		e = d;
 		d = c;
-		c = ROTL(30, b);
+		c = rotl30(b);
 		b = a;
 		a = t;
 	}
 
 	for(; i < 60; i++) {
-		t = f3(b, c, d) + K3 + ROTL(5, a) + e + W[i];
+		t = f3(b, c, d) + K3 + rotl5(a) + e + W[i];
 		e = d;
 		d = c;
-		c = ROTL(30, b);
+		c = rotl30(b);
 		b = a;
 		a = t;
 	}
 
 	for(; i < 80; i++) {
-		t = f2(b, c, d) + K4 + ROTL(5, a) + e + W[i];
+		t = f2(b, c, d) + K4 + rotl5(a) + e + W[i];
 		e = d;
 		d = c;
-		c = ROTL(30, b);
+		c = rotl30(b);
 		b = a;
 		a = t;
 	}
@@ -244,6 +261,7 @@ static void shs_transform(UINT4* digest, UINT4* in)
 	digest[3] += d;
 	digest[4] += e;
 }
+#endif
 
 /*
  * When run on a little-endian CPU we need to perform byte reversal on an
@@ -270,7 +288,7 @@ static void long_reverse(UINT4 *lbuffer, int byte_count)
 }
 
 /* Update SHS for a block of thedata */
-static void sha_update(SHA_CTX* shs_info, BYTE* buffer, unsigned count)
+static void sha_update(SHA_CTX* shs_info, const BYTE* buffer, unsigned count)
 {
 	UINT4 tmp;
 	int data_count;
@@ -308,8 +326,7 @@ static void sha_update(SHA_CTX* shs_info, BYTE* buffer, unsigned count)
 
 	/* Process thedata in SHS_DATASIZE chunks */
 	while(count >= SHS_DATASIZE) {
-		safe_memcpy((POINTER)shs_info->thedata, (POINTER)buffer,
-								SHS_DATASIZE);
+		safe_memcpy(shs_info->thedata, buffer, SHS_DATASIZE);
 		long_reverse(shs_info->thedata, SHS_DATASIZE);
 		shs_transform(shs_info->digest, shs_info->thedata);
 		buffer += SHS_DATASIZE;
@@ -317,7 +334,7 @@ static void sha_update(SHA_CTX* shs_info, BYTE* buffer, unsigned count)
 	}
 
 	/* Handle any remaining bytes of thedata. */
-	safe_memcpy((POINTER)shs_info->thedata, (POINTER)buffer, count);
+	safe_memcpy(shs_info->thedata, buffer, count);
 }
 
 /*
@@ -372,6 +389,36 @@ void sha_final(BYTE* output, SHA_CTX* shs_info)
 	/* memset((POINTER)shs_info, 0, sizeof(shs_info)); */
 }
 
+/*
+ * Replace the 20 byte buffer by its SHA-1 digest, repeated iterations times.
+ * The 20 byte input plus padding fits into a single block, hence each
+ * iteration is just one compression. As the input is the previous digest,
+ * the digest words can be used as input words without any byte conversion.
+ */
+static void sha_iterate(BYTE* buffer, unsigned iterations)
+{
+	UINT4 digest[5];
+	UINT4 block[SHS_DATASIZE / 4];
+
+	memset(block, 0, SHS_DATASIZE);
+	memcpy(block, buffer, SHS_DIGESTSIZE);
+	long_reverse(block, SHS_DIGESTSIZE);
+	block[5]  = 0x80000000;              /* padding */
+	block[15] = SHS_DIGESTSIZE * 8;      /* length in bits */
+
+	for(; iterations > 0; iterations--) {
+		digest[0] = h0init;
+		digest[1] = h1init;
+		digest[2] = h2init;
+		digest[3] = h3init;
+		digest[4] = h4init;
+		shs_transform(digest, block);
+		memcpy(block, digest, SHS_DIGESTSIZE);
+	}
+
+	sha_to_byte(buffer, block, SHS_DIGESTSIZE);
+}
+
 /* Output SHA digest in byte array */
 static void sha_to_byte(BYTE* output, UINT4* input, unsigned char len)
 {
@@ -1,14 +1,27 @@
 /* Note: see sha1.c for implementation notes and the copyright stuff */
 #define byte unsigned char
 
+/* UINT4 defines a four byte word, unsigned long is 32 bit on calculators */
+#ifdef TRTOTP_HOST
+typedef uint32_t UINT4;
+#else
+typedef unsigned long UINT4;
+#endif
+
 /* The structure for storing SHS info */
 typedef struct {
-	unsigned long digest[5];          /* Message digest */
-	unsigned long countLo, countHi;   /* 64-bit bit count */
-	unsigned long thedata[16];        /* SHS data buffer */
+	UINT4 digest[5];                  /* Message digest */
+	UINT4 countLo, countHi;           /* 64-bit bit count */
+	UINT4 thedata[16];                /* SHS data buffer */
 } SHA_CTX;
 
 /* Message digest functions */
 static void sha_init(SHA_CTX*);
-static void sha_update(SHA_CTX*, unsigned char* buffer, unsigned count);
+static void sha_update(SHA_CTX*, const unsigned char* buffer, unsigned count);
 static void sha_final(unsigned char* output, SHA_CTX*);
+
+/* One compression of a 64 byte block, exposed for the self test */
+static void shs_transform(UINT4* digest, UINT4* in);
+
+/* Key stretching: buffer (20 bytes) = SHA-1(buffer), iterations times */
+static void sha_iterate(unsigned char* buffer, unsigned iterations);
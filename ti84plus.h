@@ -14,18 +14,46 @@ __at 0x844c unsigned char curCol;
 
 __at 0x8292 unsigned char md5data[16];
 
+/* 768 bytes scratch RAM, not saved anywhere */
+__at 0x9872 unsigned char appBackUpScreen[768];
+
+/* type byte followed by up to 8 name characters */
+__at 0x8478 unsigned char OP1[11];
+
+#define AppVarObj 0x15
+
 __sfr __at 0x28   rBR_CALL;
 
+/* bit 7 clear: TI-83+ without port 0x20 */
+__sfr __at 0x02   hwStatus;
+/* 0: 6 MHz, 1-3: 15 MHz (TI-83+SE, TI-84+, TI-84+SE) */
+__sfr __at 0x20   cpuSpeed;
+
 __sfr __at 0x4546 uClrScrnFull;
 __sfr __at 0x4540 uClrLCDFull;
 __sfr __at 0x450a uPutS;
 __sfr __at 0x4972 uGetKey;
+__sfr __at 0x4018 uGetCSC;
+
+__sfr __at 0x42f1 uChkFindSym;
+__sfr __at 0x4e6a uCreateAppVar;
+__sfr __at 0x4fc6 uDelVarArc;
+__sfr __at 0x4fd8 uArc_Unarc;
+__sfr __at 0x5017 uFlashToRam;
 
 __sfr __at 0x8018 uMD5Final;
 __sfr __at 0x808d uMD5Init;
 __sfr __at 0x8090 uMD5Update;
 
+/* TRACE_BCALL: see trace.h */
 #define CALLCALC0(ROUTINE) \
+	TRACE_BCALL(ROUTINE) \
+	__asm__("rst  _rBR_CALL"); \
+	__asm__(".dw  _u" # ROUTINE);
+
+/* for bcalls polled in a loop: counted, but kept out of the trace ring */
+#define CALLCALC0_POLL(ROUTINE) \
+	TRACE_POLL(ROUTINE) \
 	__asm__("rst  _rBR_CALL"); \
 	__asm__(".dw  _u" # ROUTINE);
 
@@ -73,3 +101,26 @@ __sfr __at 0x8090 uMD5Update;
 #define kCapX  0xb1
 #define kCapY  0xb2
 #define kCapZ  0xb3
+
+/* scan codes as returned by GetCSC */
+#define skDown  0x01
+#define skLeft  0x02
+#define skRight 0x03
+#define skUp    0x04
+#define skEnter 0x09
+#define skClear 0x0f
+#define skDel   0x38
+#define sk2nd   0x36
+#define skAlpha 0x30
+#define skIdle  0xff  /* no key, see IDLE_SECONDS */
+
+#define sk0     0x21
+#define sk1     0x22
+#define sk2     0x1a
+#define sk3     0x12
+#define sk4     0x23
+#define sk5     0x1b
+#define sk6     0x13
+#define sk7     0x24
+#define sk8     0x1c
+#define sk9     0x14
@@ -0,0 +1,101 @@
+/*
+ * ---------------------------------------------
+ * -- Diagnosis -- Hot Path Counters (trace.h) --
+ * ---------------------------------------------
+ */
+
+static void trace_init()
+{
+	memset(TRACEAREA, 0, sizeof(struct trace));
+	TRACEAREA->magic = TRACE_MAGIC;
+	callcalc_read_time(&TRACEAREA->start);
+}
+
+static void trace_add(unsigned int event)
+{
+	struct trace* tr = TRACEAREA;
+	struct trace_entry* ent = tr->ring + (tr->next % TRACE_ENTRIES);
+	unsigned long now;
+
+	/* paused by screen_6_trace */
+	if(tr->magic != TRACE_MAGIC)
+		return;
+
+	trace_count(event);
+
+	callcalc_read_time(&now);
+	ent->event = event;
+	ent->time = now - tr->start;
+	tr->next++;
+}
+
+static void trace_count(unsigned int event)
+{
+	struct trace* tr = TRACEAREA;
+	unsigned char i;
+
+	if(tr->magic != TRACE_MAGIC)
+		return;
+
+	/* slots fill in order of first occurrence, excess events uncounted */
+	for(i = 0; i < TRACE_SLOTS; i++) {
+		if(tr->count[i].event == event || tr->count[i].event == 0) {
+			tr->count[i].event = event;
+			tr->count[i].n++;
+			break;
+		}
+	}
+}
+
+#ifndef TRTOTP_CE
+/*
+ * Called by TRACE_BCALL with the bcall address in HL. Saves the registers
+ * the bcall might take arguments in, TRACE_BCALL saves AF and HL.
+ */
+static void trace_bcall() __naked
+{
+	__asm__("push bc");
+	__asm__("push de");
+	__asm__("push ix");
+	__asm__("push hl");
+	__asm__("call _trace_add");
+	__asm__("pop  hl");
+	__asm__("pop  ix");
+	__asm__("pop  de");
+	__asm__("pop  bc");
+	__asm__("ret");
+}
+
+/* The same for TRACE_POLL */
+static void trace_bcall_poll() __naked
+{
+	__asm__("push bc");
+	__asm__("push de");
+	__asm__("push ix");
+	__asm__("push hl");
+	__asm__("call _trace_count");
+	__asm__("pop  hl");
+	__asm__("pop  ix");
+	__asm__("pop  de");
+	__asm__("pop  bc");
+	__asm__("ret");
+}
+#endif
+
+static void trace_label(unsigned int event, unsigned char* out)
+{
+	static const char HEXDIGITS[] = "0123456789ABCDEF";
+	unsigned char i;
+
+	switch(event) {
+	case TRACE_SHS:  memcpy(out, "SHS ", 4); break;
+	case TRACE_HMAC: memcpy(out, "HMAC", 4); break;
+	case TRACE_HOTP: memcpy(out, "HOTP", 4); break;
+	case TRACE_MD5:  memcpy(out, "MD5 ", 4); break;
+	default:
+		/* bcall address as in ti84plus.h */
+		for(i = 0; i < 4; i++)
+			out[i] = HEXDIGITS[(event >> (12 - 4 * i)) & 0xf];
+		break;
+	}
+}
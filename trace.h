@@ -0,0 +1,78 @@
+/*
+ * Hot path counters for diagnosis, compiled in with -DTRTOTP_TRACE only
+ * (see Makefile: TRACE). Every SHA-1 block, HMAC, HOTP code, MD5 and bcall
+ * (TI-84+, by CALLCALC0) is counted per event and logged with the time since
+ * program start into a ring of the last TRACE_ENTRIES events. Polled bcalls
+ * (GetCSC, by CALLCALC0_POLL) are counted only, at some 100 per second they
+ * would push everything else out of the ring. The trace
+ * lives at the end of appBackUpScreen, behind the scratch area, and is kept
+ * at exit such that emu/trtotp_emu -T can print it. Without TRTOTP_TRACE,
+ * all of it compiles to nothing.
+ */
+#ifdef TRTOTP_TRACE
+
+/* events, bcalls are logged by their address (0x4000 and above) */
+#define TRACE_SHS   1  /* shs_transform */
+#define TRACE_HMAC  2  /* hmac_sha1_outer, i.e. each HMAC computed */
+#define TRACE_HOTP  3  /* hotp_outer, i.e. each code computed */
+#define TRACE_MD5   4  /* callcalc_md5_compute */
+
+#define TRACE_MAGIC   0x5254  /* "TR" */
+#define TRACE_SLOTS   16
+#define TRACE_ENTRIES 32
+
+struct trace_count {
+	unsigned int event;     /* 0: unused */
+	unsigned long n;
+};
+
+struct trace_entry {
+	unsigned int event;
+	unsigned int time;      /* seconds since trace_init */
+};
+
+/* aligned with emu/trtotp_emu.c */
+struct trace {
+	unsigned int magic;     /* 0 while paused */
+	unsigned long next;     /* events logged, ring[next % TRACE_ENTRIES] */
+	unsigned long start;    /* calculator clock at trace_init */
+	struct trace_count count[TRACE_SLOTS];
+	struct trace_entry ring[TRACE_ENTRIES];
+};
+
+#define TRACEAREA ((struct trace*)(appBackUpScreen + \
+			sizeof(appBackUpScreen) - sizeof(struct trace)))
+
+#define TRACE(EVENT) trace_add(EVENT)
+
+/* before each bcall, HL holds the address, all registers are preserved */
+#define TRACE_BCALL(ROUTINE) \
+	__asm__("push af"); \
+	__asm__("push hl"); \
+	__asm__("ld   hl, #_u" # ROUTINE); \
+	__asm__("call _trace_bcall"); \
+	__asm__("pop  hl"); \
+	__asm__("pop  af");
+
+/* the same, counted only */
+#define TRACE_POLL(ROUTINE) \
+	__asm__("push af"); \
+	__asm__("push hl"); \
+	__asm__("ld   hl, #_u" # ROUTINE); \
+	__asm__("call _trace_bcall_poll"); \
+	__asm__("pop  hl"); \
+	__asm__("pop  af");
+
+static void trace_init();
+static void trace_add(unsigned int event);
+static void trace_count(unsigned int event);
+/* 4 characters naming event, not terminated */
+static void trace_label(unsigned int event, unsigned char* out);
+
+#else
+
+#define TRACE(EVENT)
+#define TRACE_BCALL(ROUTINE)
+#define TRACE_POLL(ROUTINE)
+
+#endif
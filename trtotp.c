@@ -1,13 +1,35 @@
 #include <string.h>
 
+#ifdef TRTOTP_CE
+#include "ce/ti84pce.h"
+#else
 #include "ti84plus.h"
+#endif
 #include "calculator_routines.h"
 #include "sha1.h"
 #include "hmac-sha1.h"
 #include "hotp.h"
+#include "trace.h"
 
 /* -- Structures -- */
 #define MAXKEYLENGTH 20
+#define SHA1_STATELENGTH 20
+
+#define TYPE_TOTP 0
+#define TYPE_HOTP 1 /* timestep unused, counter in COUNTERVAR */
+#define TYPE_MIDSTATE 2 /* flag: key holds HMAC ipad and opad SHA-1 states */
+
+/*
+ * keys.inc generated with midstates=1 has records of TYPE_MIDSTATE which
+ * need the larger key field, compile with -DKEY_MIDSTATES for them. The
+ * SHA-1 states after the key blocks replace the seed such that only the two
+ * message blocks remain to be computed per code, whatever the seed length.
+ */
+#ifdef KEY_MIDSTATES
+#define KEYFIELDLENGTH (2 * SHA1_STATELENGTH)
+#else
+#define KEYFIELDLENGTH MAXKEYLENGTH
+#endif
 
 struct db_entry {
 	unsigned char name[16]; /* max 15 chars + trailing '0' */
@@ -15,7 +37,31 @@ struct db_entry {
 	unsigned char keylen;
 	unsigned char timestep;
 	unsigned char digits;
-	unsigned char key[MAXKEYLENGTH]; /* encrypted */
+	unsigned char key[KEYFIELDLENGTH]; /* encrypted */
+};
+
+/* last code computed per entry, lives in appBackUpScreen */
+struct code_cache {
+	unsigned long step; /* 0: empty */
+	unsigned long code;
+};
+
+/*
+ * Code of the highlighted menu entry computed while the menu waits for a
+ * key, one SHA-1 block per call to precompute_slice.
+ */
+struct precompute {
+	unsigned char entryidx;
+	unsigned char stage;    /* PRECOMPUTE_* */
+	unsigned long step;
+	HMAC_CTX hmac;
+	unsigned char innerhash[20];
+};
+
+/* AppVar COUNTERVAR holds one of these per HOTP entry */
+struct counter_rec {
+	unsigned char name[16];
+	unsigned long counter;  /* next unused counter value */
 };
 
 /* -- Constants -- */
@@ -31,6 +77,65 @@ static const struct db_entry DATABASE[] = {
 
 #define NUM_DB_ENTRIES (sizeof(DATABASE)/sizeof(struct db_entry))
 
+/* keys.inc from older versions of secret_keys_to_inc.pl do not set this */
+#ifndef KDF_ITERATIONS
+#define KDF_ITERATIONS 0
+#endif
+
+/*
+ * Number of SHA-1 iterations applied to the password derived key, aligned
+ * with Perl code. Not static such that the emulator can find and patch it
+ * for calibration (emu/trtotp_emu -C), volatile such that sdcc reads it
+ * from memory rather than folding the constant into the caller.
+ */
+volatile const unsigned int KDFITERATIONS = KDF_ITERATIONS;
+
+/*
+ * appBackUpScreen layout: code cache, HOTP counters, then either the AppVar
+ * contents (counters_load/counters_save only) or the menu's precomputation
+ * whose HMAC_CTX the code screens share. Kept off the stack which has
+ * little room above the VAT.
+ */
+#define CODECACHE ((struct code_cache*)appBackUpScreen)
+#define CODECACHESZ (NUM_DB_ENTRIES * sizeof(struct code_cache))
+#define COUNTERS ((unsigned long*)(appBackUpScreen + CODECACHESZ))
+#define COUNTERSSZ (NUM_DB_ENTRIES * sizeof(unsigned long))
+#define COUNTERRECS ((struct counter_rec*)(appBackUpScreen + CODECACHESZ + \
+								COUNTERSSZ))
+#define COUNTERRECSSZ (NUM_DB_ENTRIES * sizeof(struct counter_rec))
+#define PRECOMPUTE ((struct precompute*)COUNTERRECS)
+#define SHAREDSZ ((COUNTERRECSSZ > sizeof(struct precompute)) ? \
+				COUNTERRECSSZ : sizeof(struct precompute))
+#define SCRATCHSZ (CODECACHESZ + COUNTERSSZ + SHAREDSZ)
+
+/* fails to compile if the scratch area does not fit */
+typedef char scratch_fits[(SCRATCHSZ <= sizeof(appBackUpScreen)) ? 1 : -1];
+
+#ifdef TRTOTP_TRACE
+/* TRACEAREA follows at the end of appBackUpScreen, fails if they overlap */
+typedef char trace_fits_behind_scratch[(SCRATCHSZ + sizeof(struct trace) <=
+					sizeof(appBackUpScreen)) ? 1 : -1];
+#endif
+
+/*
+ * Counters are keyed by entry name such that adding or removing entries
+ * does not mix them up. They are read at start and written back (one Flash
+ * write) at exit only if any of them changed. The AppVar may also go by
+ * COUNTERSPARE, see callcalc_appvar_write.
+ */
+#define COUNTERVAR   "TRTOTPC"
+#define COUNTERSPARE "TRTOTPD"
+
+/* number of HOTP codes shown at once */
+#define LOOKAHEAD 5
+
+/* struct precompute stages, in order */
+#define PRECOMPUTE_IPAD  0
+#define PRECOMPUTE_OPAD  1
+#define PRECOMPUTE_INNER 2
+#define PRECOMPUTE_OUTER 3
+#define PRECOMPUTE_DONE  4
+
 /*
  * If you are in UTC+2 write  7200 for 3600*2    = 7200
  * If you are in UTC-1 write -3600 for 3600*(-1) = -3600
@@ -45,7 +150,7 @@ static const struct db_entry DATABASE[] = {
 
 #define ENTRIES_PER_PAGE   (SCREEN_HEIGHT - 1)
 
-/* random bytes, aligned with Perl code */
+/* random bytes, aligned with Perl code and host/pad_bench.c */
 const unsigned char PASSWORDPADDINGBYTES[PASSWORDMEMSZ] = {
 	0xc5, 0xf7, 0x40, 0xd8, 0x1f, 0xda, 0x49, 0xb6,
 	0xe6, 0x1b, 0x5c, 0xee, 0xbd, 0x29, 0xbb, 0xa5,
@@ -53,28 +158,130 @@ const unsigned char PASSWORDPADDINGBYTES[PASSWORDMEMSZ] = {
 	0xbb, 0x5a, 0xb4, 0x05, 0x1b, 0x9a, 0xe7, 0x4d
 };
 
+/* RFC 6238 Appendix B, SHA-1 mode: 8 digits, 30 s time step */
+static const unsigned char SELFTEST_KEY[20] = "12345678901234567890";
+static const unsigned long SELFTEST_STEP[] = {
+	1, 37037036, 37037037, 41152263, 66666666, 666666666
+};
+static const unsigned long SELFTEST_CODE[] = {
+	94287082, 7081804, 14050471, 89005924, 69279037, 65353130
+};
+
+#define NUM_SELFTEST (sizeof(SELFTEST_STEP)/sizeof(unsigned long))
+
+/* the clock has a resolution of 1 s, hence measure several seconds */
+#define BENCH_SECONDS 3
+#define BENCH_HMAC    0
+#define BENCH_SHS     1
+
+/* -- Variables -- */
+static unsigned char counters_dirty;
+
 /* -- Declarations -- */
+static void counters_load();
+static void counters_merge(unsigned int len);
+static void counters_save();
 static unsigned char set_decryption_key(unsigned char* key);
+static void entry_key(unsigned char entryidx, unsigned char* key_xor,
+							HMAC_CTX* ctx);
+static void entry_key_pad(unsigned char entryidx, unsigned char* key_xor,
+					SHA_CTX* sha, unsigned char pad);
 static unsigned char screen_1_get_password(unsigned char* password);
 static void screen_2_main_select_token(unsigned char* key);
+static unsigned char menu_wait_key(struct precompute* pre,
+							unsigned char* key_xor);
+static void precompute_begin(struct precompute* pre, unsigned long now);
+static void precompute_slice(struct precompute* pre, unsigned char* key_xor);
 static void display_digits(unsigned long val, unsigned char digits);
-
-static void display_totp(unsigned char entryidx, unsigned char* key_decr,
-						unsigned long* update_step);
-static void screen_3_totp(unsigned char entryidx, unsigned char* key);
+static unsigned long unix_time(unsigned long now);
+
+static unsigned long get_code(unsigned char entryidx, unsigned char* key_xor,
+							unsigned long step);
+static void display_totp(unsigned char entryidx, unsigned char* key_xor,
+				unsigned long* update_step, unsigned long now);
+static unsigned char screen_3_totp(unsigned char entryidx,
+							unsigned char* key);
+static void screen_3_hotp(unsigned char entryidx, unsigned char* key_xor);
 static void screen_4_info();
+static void screen_5_selftest();
+#ifdef TRTOTP_TRACE
+static void screen_6_trace();
+#endif
+static unsigned long bench(unsigned char op);
 
 /* -- Main Implementation -- */
 void main()
 {
-	unsigned char decryption_key[MAXKEYLENGTH];
+	unsigned char decryption_key[KEYFIELDLENGTH];
 
+#ifdef TRTOTP_TRACE
+	trace_init();
+#endif
 	callcalc_clear_lcd_full();
 
-	if(!set_decryption_key(decryption_key))
-		return; /* user cancelled */
+	/* scratch RAM may hold anything, including codes from an earlier run */
+	memset(appBackUpScreen, 0, SCRATCHSZ);
+	counters_load();
+
+	if(set_decryption_key(decryption_key))
+		screen_2_main_select_token(decryption_key);
+
+	/* if the OS ends the program while saving, nothing secret is left */
+	memset(decryption_key, 0, sizeof(decryption_key));
+	memset(CODECACHE, 0, CODECACHESZ);
+	memset(PRECOMPUTE, 0, SHAREDSZ);
+	counters_save();
+	memset(appBackUpScreen, 0, SCRATCHSZ);
+}
+
+static void counters_load()
+{
+	counters_dirty = 0;
+
+	/* both exist only after a failed save, counters never decrease */
+	counters_merge(callcalc_appvar_read(COUNTERVAR, COUNTERRECS,
+							COUNTERRECSSZ));
+	counters_merge(callcalc_appvar_read(COUNTERSPARE, COUNTERRECS,
+							COUNTERRECSSZ));
+}
+
+/*
+ * COUNTERS = maximum of COUNTERS and the len bytes read to COUNTERRECS.
+ * Names from the AppVar may lack the trailing 0, hence compare 16 at most.
+ */
+static void counters_merge(unsigned int len)
+{
+	unsigned char i;
+	unsigned char j;
+
+	for(j = 0; j < len / sizeof(struct counter_rec); j++)
+		for(i = 0; i < NUM_DB_ENTRIES; i++)
+			if((DATABASE[i].type & TYPE_HOTP) &&
+					strncmp(DATABASE[i].name,
+					COUNTERRECS[j].name,
+					sizeof(COUNTERRECS[j].name)) == 0 &&
+					COUNTERRECS[j].counter > COUNTERS[i])
+				COUNTERS[i] = COUNTERRECS[j].counter;
+}
+
+static void counters_save()
+{
+	unsigned char i;
+	unsigned char num = 0;
+
+	if(!counters_dirty)
+		return;
+
+	for(i = 0; i < NUM_DB_ENTRIES; i++) {
+		if(DATABASE[i].type & TYPE_HOTP) {
+			memcpy(COUNTERRECS[num].name, DATABASE[i].name, 16);
+			COUNTERRECS[num].counter = COUNTERS[i];
+			num++;
+		}
+	}
 
-	screen_2_main_select_token(decryption_key);
+	callcalc_appvar_write(COUNTERVAR, COUNTERSPARE, COUNTERRECS,
+					num * sizeof(struct counter_rec));
 }
 
 static unsigned char set_decryption_key(unsigned char* key)
@@ -87,6 +294,7 @@ static unsigned char set_decryption_key(unsigned char* key)
 	/* this string will not be 0-terminated */
 	unsigned char password[PASSWORDMEMSZ];
 	unsigned char pwlen = PASSWORDMEMSZ;
+	unsigned char speed;
 
 	memcpy(password, PASSWORDPADDINGBYTES, PASSWORDMEMSZ);
 
@@ -94,6 +302,7 @@ static unsigned char set_decryption_key(unsigned char* key)
 		return 0; /* user cancelled */
 
 	inptr = password;
+	speed = callcalc_cpu_fast();
 
 	while(key_offset < MAXKEYLENGTH) {
 		callcalc_md5_compute(inptr, pwlen);
@@ -110,9 +319,49 @@ static unsigned char set_decryption_key(unsigned char* key)
 		key_offset += numcpy;
 	}
 
+	sha_iterate(key, KDFITERATIONS);
+
+#ifdef KEY_MIDSTATES
+	/* pad for the opad state, aligned with Perl code */
+	memcpy(key + MAXKEYLENGTH, key, SHA1_STATELENGTH);
+	sha_iterate(key + MAXKEYLENGTH, 1);
+#endif
+
+	callcalc_cpu_restore(speed);
 	return 1; /* OK */
 }
 
+/* HMAC key setup for entry entryidx, see entry_key_pad */
+static void entry_key(unsigned char entryidx, unsigned char* key_xor,
+							HMAC_CTX* ctx)
+{
+	entry_key_pad(entryidx, key_xor, &ctx->inner, IPAD_BYTE);
+	entry_key_pad(entryidx, key_xor, &ctx->outer, OPAD_BYTE);
+}
+
+/*
+ * Sets sha to the state after the key ^ pad block of entry entryidx. Costs
+ * one SHA-1 block for seeds and none for records of TYPE_MIDSTATE.
+ */
+static void entry_key_pad(unsigned char entryidx, unsigned char* key_xor,
+					SHA_CTX* sha, unsigned char pad)
+{
+	unsigned char use_key[KEYFIELDLENGTH];
+
+	memcpy(use_key, key_xor, KEYFIELDLENGTH);
+	memxor(use_key, DATABASE[entryidx].key, KEYFIELDLENGTH);
+
+#ifdef KEY_MIDSTATES
+	if(DATABASE[entryidx].type & TYPE_MIDSTATE)
+		hmac_sha1_midstate(sha, (pad == IPAD_BYTE) ? use_key :
+					(use_key + SHA1_STATELENGTH));
+	else
+#endif
+		hmac_sha1_pad(sha, use_key, DATABASE[entryidx].keylen, pad);
+
+	memset(use_key, 0, KEYFIELDLENGTH);
+}
+
 static unsigned char screen_1_get_password(unsigned char* password)
 {
 	unsigned char idx = 0;
@@ -164,6 +413,7 @@ static unsigned char screen_1_get_password(unsigned char* password)
 
 static void screen_2_main_select_token(unsigned char* key)
 {
+	struct precompute* pre = PRECOMPUTE;
 	unsigned char pagoff = 0;
 	unsigned char cursor = 0;
 	unsigned char i;
@@ -190,23 +440,32 @@ static void screen_2_main_select_token(unsigned char* key)
 				callcalc_puts(DATABASE[entry].name);
 		}
 
-		switch(callcalc_get_key()) {
-		case kDown:
+		/* info line or empty line: nothing to precompute */
+		pre->entryidx = (cursor == 0) ? NUM_DB_ENTRIES :
+							(pagoff + cursor - 1);
+
+		switch(menu_wait_key(pre, key)) {
+		case skDown:
 			cursor = (cursor + 1) % SCREEN_HEIGHT;
 			break;
-		case kUp:
+		case skUp:
 			if(cursor == 0)
 				cursor = (SCREEN_HEIGHT - 1);
 			else
 				cursor--;
 			break;
-		case kEnter:
+		case skEnter:
 			if(cursor == 0)
 				screen_4_info();
-			else if((pagoff + cursor) <= NUM_DB_ENTRIES)
-				screen_3_totp(pagoff + cursor - 1, key);
+			else if((pagoff + cursor) > NUM_DB_ENTRIES)
+				break;
+			else if(DATABASE[pagoff + cursor - 1].type & TYPE_HOTP)
+				screen_3_hotp(pagoff + cursor - 1, key);
+			else if(screen_3_totp(pagoff + cursor - 1, key) ==
+									skIdle)
+				return; /* see IDLE_SECONDS */
 			break;
-		case kLeft:
+		case skLeft:
 			if(pagoff >= ENTRIES_PER_PAGE)
 				pagoff -= ENTRIES_PER_PAGE;
 			break;
@@ -215,18 +474,99 @@ static void screen_2_main_select_token(unsigned char* key)
 		 * it is only needed if you have more than ENTRIES_PER_PAGE
 		 * entries.
 		 */
-		case kRight:
+		case skRight:
 			if(pagoff/ENTRIES_PER_PAGE <
 					NUM_DB_ENTRIES/ENTRIES_PER_PAGE)
 				pagoff += ENTRIES_PER_PAGE;
 			break;
-		/* kDel */
+		/* modifiers, ignored like GetKey does */
+		case sk2nd:
+		case skAlpha:
+			break;
+		/* skDel, skIdle; main clears the HMAC states in PRECOMPUTE */
 		default:
 			return;
 		}
 	}
 }
 
+/*
+ * Waits for a key like callcalc_wait_event but uses the time to compute the
+ * code of entry pre->entryidx for the current time step into CODECACHE such
+ * that it shows up instantly when selected. Keys are polled between SHA-1
+ * blocks hence moving the cursor abandons the computation after one block
+ * at most. Returns the scan code of the key pressed or skIdle if there was
+ * none for IDLE_SECONDS. Unlike GetKey, GetCSC has no autorepeat, i.e.
+ * a held arrow key moves the cursor by one line only.
+ */
+static unsigned char menu_wait_key(struct precompute* pre,
+							unsigned char* key_xor)
+{
+	unsigned long now;
+	unsigned char scancode;
+
+	callcalc_read_time(&now);
+	callcalc_idle_reset(now);
+	precompute_begin(pre, now);
+
+	while(1) {
+		if(pre->stage == PRECOMPUTE_DONE) {
+			if((scancode = callcalc_wait_event(&now)) != 0)
+				return scancode;
+			/* clock advanced: code may be due for the next step */
+			precompute_begin(pre, now);
+		} else {
+			if((scancode = callcalc_get_csc()) != 0)
+				return scancode;
+			precompute_slice(pre, key_xor);
+		}
+	}
+}
+
+/* Starts over for pre->entryidx unless the cache is current already */
+static void precompute_begin(struct precompute* pre, unsigned long now)
+{
+	pre->stage = PRECOMPUTE_DONE;
+
+	/* HOTP codes are computed on demand only, they count as used */
+	if(pre->entryidx >= NUM_DB_ENTRIES ||
+				(DATABASE[pre->entryidx].type & TYPE_HOTP))
+		return;
+
+	pre->step = unix_time(now) / DATABASE[pre->entryidx].timestep;
+	if(CODECACHE[pre->entryidx].step != pre->step)
+		pre->stage = PRECOMPUTE_IPAD;
+}
+
+/* Advances pre by one SHA-1 block, the last one fills CODECACHE */
+static void precompute_slice(struct precompute* pre, unsigned char* key_xor)
+{
+	struct code_cache* cache = CODECACHE + pre->entryidx;
+	unsigned char speed = callcalc_cpu_fast();
+
+	switch(pre->stage) {
+	case PRECOMPUTE_IPAD:
+		entry_key_pad(pre->entryidx, key_xor, &pre->hmac.inner,
+								IPAD_BYTE);
+		break;
+	case PRECOMPUTE_OPAD:
+		entry_key_pad(pre->entryidx, key_xor, &pre->hmac.outer,
+								OPAD_BYTE);
+		break;
+	case PRECOMPUTE_INNER:
+		hotp_inner(&pre->hmac, pre->step, pre->innerhash);
+		break;
+	case PRECOMPUTE_OUTER:
+		hotp_outer(&pre->hmac, pre->innerhash,
+				DATABASE[pre->entryidx].digits, &cache->code);
+		cache->step = pre->step;
+		break;
+	}
+	pre->stage++;
+
+	callcalc_cpu_restore(speed);
+}
+
 /* at most 10 digits */
 static void display_digits(unsigned long val, unsigned char digits)
 {
@@ -251,12 +591,13 @@ static void display_digits(unsigned long val, unsigned char digits)
 	callcalc_puts(outstr);
 }
 
-static void screen_3_totp(unsigned char entryidx, unsigned char* key_xor)
+/* Returns the scan code which ended the live view, skIdle on timeout */
+static unsigned char screen_3_totp(unsigned char entryidx,
+							unsigned char* key_xor)
 {
-	unsigned char use_key[MAXKEYLENGTH];
-
 	unsigned long update_step = 0;
-	unsigned char key;
+	unsigned long now;
+	unsigned char scancode;
 
 	callcalc_clear_lcd_full();
 
@@ -264,40 +605,143 @@ static void screen_3_totp(unsigned char entryidx, unsigned char* key_xor)
 	curCol = 0;
 	callcalc_puts(DATABASE[entryidx].name);
 
-	memcpy(use_key, key_xor, MAXKEYLENGTH);
-	memxor(use_key, DATABASE[entryidx].key, MAXKEYLENGTH);
-
 	curRow = 1;
 	curCol = 0;
-	callcalc_puts("0:Back,1:Update");
+	callcalc_puts("0:Back");
 
+	/* live view: sleeps between clock ticks, see callcalc_wait_event */
+	callcalc_read_time(&now);
+	callcalc_idle_reset(now);
 	do {
-		display_totp(entryidx, use_key, &update_step);
-	} while((key = callcalc_get_key()) != k0 && key != kDel);
+		display_totp(entryidx, key_xor, &update_step, now);
+	} while((scancode = callcalc_wait_event(&now)) != sk0 &&
+					scancode != skDel && scancode != skIdle);
+
+	return scancode;
+}
+
+/*
+ * Code of entry entryidx for the given time step. Served from CODECACHE if
+ * it was computed for the same step before, e.g. when switching between
+ * entries within the same 30 seconds.
+ */
+static unsigned long get_code(unsigned char entryidx, unsigned char* key_xor,
+							unsigned long step)
+{
+	HMAC_CTX* ctx = &PRECOMPUTE->hmac;  /* menu restarts it anyway */
+	struct code_cache* cache = CODECACHE + entryidx;
+	unsigned char speed;
+
+	if(cache->step != step) {
+		speed = callcalc_cpu_fast();
+		entry_key(entryidx, key_xor, ctx);
+		hotp_ctx(ctx, step, DATABASE[entryidx].digits, &cache->code);
+		cache->step = step;
+		callcalc_cpu_restore(speed);
+	}
+
+	return cache->code;
+}
+
+/*
+ * Event based tokens: shows the codes for the next LOOKAHEAD counter values.
+ * The first one counts as used once displayed. ENTER marks all codes up to
+ * the cursor as used, this allows catching up with a server that is ahead.
+ * The key blocks are hashed once per visit, each code then costs only two
+ * SHA-1 blocks and codes still ahead are kept when advancing.
+ */
+static void screen_3_hotp(unsigned char entryidx, unsigned char* key_xor)
+{
+	HMAC_CTX* ctx = &PRECOMPUTE->hmac;  /* see get_code */
+	unsigned long codes[LOOKAHEAD];
+	unsigned long base = COUNTERS[entryidx];
+	unsigned char valid = 0;    /* codes[0..valid) are for base.. */
+	unsigned char cursor = 0;
+	unsigned char digits = DATABASE[entryidx].digits;
+	unsigned char speed;
+	unsigned char i;
+
+	callcalc_clear_lcd_full();
+
+	curRow = 0;
+	curCol = 0;
+	callcalc_puts(DATABASE[entryidx].name);
+
+	curRow = 1;
+	curCol = 0;
+	callcalc_puts("0:Back ENT:Next");
+
+	speed = callcalc_cpu_fast();
+	entry_key(entryidx, key_xor, ctx);
+	callcalc_cpu_restore(speed);
+
+	while(1) {
+		speed = callcalc_cpu_fast();
+		for(i = valid; i < LOOKAHEAD; i++)
+			hotp_ctx(ctx, base + i, digits, codes + i);
+		callcalc_cpu_restore(speed);
+		valid = LOOKAHEAD;
+
+		if(COUNTERS[entryidx] != base + 1) {
+			COUNTERS[entryidx] = base + 1;
+			counters_dirty = 1;
+		}
+
+		for(i = 0; i < LOOKAHEAD; i++) {
+			curRow = 3 + i;
+			curCol = 0;
+			callcalc_puts((i == cursor) ? ">" : " ");
+			display_digits(base + i, 5);
+			callcalc_puts(" ");
+			display_digits(codes[i], digits);
+		}
+
+		switch(callcalc_get_key()) {
+		case kDown:
+			cursor = (cursor + 1) % LOOKAHEAD;
+			break;
+		case kUp:
+			cursor = (cursor == 0) ? (LOOKAHEAD - 1) : (cursor - 1);
+			break;
+		case kEnter:
+			/* codes up to the cursor are used, keep those after */
+			cursor++;
+			base += cursor;
+			valid = LOOKAHEAD - cursor;
+			memmove(codes, codes + cursor,
+					valid * sizeof(unsigned long));
+			cursor = 0;
+			break;
+		/* k0, kDel */
+		default:
+			return;
+		}
+	}
 }
 
-static void display_totp(unsigned char entryidx, unsigned char* key_decr,
-						unsigned long* update_step)
+static void display_totp(unsigned char entryidx, unsigned char* key_xor,
+				unsigned long* update_step, unsigned long now)
 {
 	unsigned char digits;
-	unsigned long rv = 0;
+	unsigned char timestep = DATABASE[entryidx].timestep;
+	unsigned long rv;
 	unsigned long output;
 
-	callcalc_read_time(&rv);
+	now = unix_time(now);
 
-	/* Now we have time since 1997-01-01 00:00:00 in seconds */
-	/* TZ=UTC date --date="Jan 1 1997 UTC 00:00:00" +%s */
-	rv = rv + 852076800 - (TZ_OFFSET_SECONDS);
-	/* Now we have an UNIX timestamp */
+	rv = now / timestep;
 
-	rv /= DATABASE[entryidx].timestep;
+	/* seconds until the code changes */
+	curRow = 5;
+	curCol = 7;
+	display_digits(timestep - (now - rv * timestep),
+						(timestep < 100) ? 2 : 3);
 
 	/* improve update performance */
 	if(rv == *update_step)
 		return;
 
-	hotp(key_decr, DATABASE[entryidx].keylen, rv,
-					DATABASE[entryidx].digits, &output);
+	output = get_code(entryidx, key_xor, rv);
 	*update_step = rv;
 
 	digits = DATABASE[entryidx].digits;
@@ -307,6 +751,13 @@ static void display_totp(unsigned char entryidx, unsigned char* key_decr,
 	display_digits(output, digits);
 }
 
+/* calculator clock (seconds since 1997-01-01 00:00:00) to UNIX timestamp */
+static unsigned long unix_time(unsigned long now)
+{
+	/* TZ=UTC date --date="Jan 1 1997 UTC 00:00:00" +%s */
+	return now + 852076800 - (TZ_OFFSET_SECONDS);
+}
+
 static void screen_4_info()
 {
 	unsigned char row;
@@ -320,8 +771,8 @@ static void screen_4_info()
 		"/konamiman.com",   /* 4 */
 		"GPL2+ hmac-sha1",  /* 5 */
 		"2005, 2006, FSF",  /* 6 */
-		"-> https://is.gd", /* 7 */
-		"/nqUeRL  0:Back",  /* 8 */
+		"-> is.gd/nqUeRL",  /* 7 */
+		"0:Back  1:Test",   /* 8 */
 	};
 
 	callcalc_clear_lcd_full();
@@ -332,11 +783,182 @@ static void screen_4_info()
 		callcalc_puts(text[row]);
 	}
 
+	/* any other key goes back */
+	switch(callcalc_get_key()) {
+	case k1:
+		screen_5_selftest();
+		break;
+#ifdef TRTOTP_TRACE
+	case k2:
+		screen_6_trace();
+		break;
+#endif
+	}
+}
+
+/*
+ * Diagnostics for a given calculator: checks hotp() against the RFC 6238
+ * test vectors and measures hmac_sha1 and shs_transform using the clock.
+ */
+static void screen_5_selftest()
+{
+	unsigned char i;
+	unsigned char passed = 0;
+	unsigned char speed;
+	unsigned long output;
+
+	callcalc_clear_lcd_full();
+
+	curRow = 0;
+	curCol = 0;
+	callcalc_puts("SELF TEST");
+
+	speed = callcalc_cpu_fast();
+
+	curRow = 1;
+	curCol = 0;
+	callcalc_puts("RFC6238 ");
+	for(i = 0; i < NUM_SELFTEST; i++) {
+		hotp((unsigned char*)SELFTEST_KEY, sizeof(SELFTEST_KEY),
+					SELFTEST_STEP[i], 8, &output);
+		if(output == SELFTEST_CODE[i])
+			passed++;
+	}
+	display_digits(passed, 1);
+	callcalc_puts("/");
+	display_digits(NUM_SELFTEST, 1);
+	callcalc_puts((passed == NUM_SELFTEST) ? " OK" : " FAIL");
+
+	curRow = 2;
+	curCol = 0;
+	callcalc_puts("CPU MHZ   ");
+	display_digits(callcalc_cpu_mhz(), 2);
+
+	curRow = 3;
+	curCol = 0;
+	callcalc_puts("HMAC MS   ");
+	display_digits(bench(BENCH_HMAC), 5);
+
+	curRow = 4;
+	curCol = 0;
+	callcalc_puts("SHS MS    ");
+	display_digits(bench(BENCH_SHS), 5);
+
+	callcalc_cpu_restore(speed);
+
+	curRow = 7;
+	curCol = 0;
+	callcalc_puts("0:Back");
+
 	callcalc_get_key();
 }
 
+/*
+ * Runs op from one clock tick until BENCH_SECONDS have passed and returns
+ * the milliseconds per run (rounded down, the last run may overlap the end).
+ */
+static unsigned long bench(unsigned char op)
+{
+	unsigned long start;
+	unsigned long now;
+	unsigned int runs = 0;
+	unsigned long state[5];
+	unsigned long block[16];
+	unsigned char digest[20];
+
+	memset(state, 0, sizeof(state));
+	memset(block, 0, sizeof(block));
+
+	callcalc_read_time(&start);
+	do {
+		callcalc_halt();
+		callcalc_read_time(&now);
+	} while(now == start);
+	start = now;
+
+	do {
+		if(op == BENCH_HMAC)
+			hmac_sha1(SELFTEST_KEY, sizeof(SELFTEST_KEY),
+						SELFTEST_KEY, 8, digest);
+		else
+			shs_transform(state, block);
+		runs++;
+		callcalc_read_time(&now);
+	} while(now - start < BENCH_SECONDS);
+
+	return BENCH_SECONDS * 1000UL / runs;
+}
+
+#ifdef TRTOTP_TRACE
+/*
+ * Shows the counters of trace.h, then the ring newest first as event and
+ * seconds since program start (@), seven per page. Tracing is paused such
+ * that the bcalls of this screen do not push out the events of interest.
+ */
+static void screen_6_trace()
+{
+	struct trace* tr = TRACEAREA;
+	struct trace_entry* ent;
+	unsigned char label[5];
+	unsigned char numslots = 0;
+	unsigned char total;
+	unsigned char first = 0;
+	unsigned char item;
+	unsigned char row;
+
+	tr->magic = 0;
+
+	while(numslots < TRACE_SLOTS && tr->count[numslots].event != 0)
+		numslots++;
+	total = numslots + ((tr->next < TRACE_ENTRIES) ? tr->next :
+								TRACE_ENTRIES);
+	label[4] = 0;
+
+	do {
+		callcalc_clear_lcd_full();
+
+		for(row = 0; row < SCREEN_HEIGHT - 1 && first + row < total;
+									row++) {
+			item = first + row;
+			curRow = row;
+			curCol = 0;
+			if(item < numslots) {
+				trace_label(tr->count[item].event, label);
+				callcalc_puts(label);
+				callcalc_puts(" ");
+				display_digits(tr->count[item].n, 10);
+			} else {
+				ent = tr->ring + ((tr->next - 1 -
+					(item - numslots)) % TRACE_ENTRIES);
+				trace_label(ent->event, label);
+				callcalc_puts(label);
+				callcalc_puts(" @");
+				display_digits(ent->time, 5);
+			}
+		}
+
+		curRow = SCREEN_HEIGHT - 1;
+		curCol = 0;
+		callcalc_puts("0:Back ENT:Next");
+
+		first += SCREEN_HEIGHT - 1;
+		if(first >= total)
+			first = 0;
+	} while(callcalc_get_key() == kEnter);
+
+	tr->magic = TRACE_MAGIC;
+}
+#endif
+
 /* -- Auxiliary and Low Level Routines -- */
+#ifdef TRTOTP_CE
+#include "ce/calculator_routines_ce.c"
+#else
 #include "calculator_routines.c"
+#endif
+#ifdef TRTOTP_TRACE
+#include "trace.c"
+#endif
 
 /* -- Crypto Routines -- */
 #include "sha1.c"